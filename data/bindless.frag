@@ -0,0 +1,21 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+
+layout(set = 3, binding = 1) readonly buffer Palette { vec4 colors[]; } bindlessPalettes[];
+
+// Bindless buffer handle and the entry to tint with
+layout(push_constant) uniform Material
+{
+    uint palette;
+    uint entry;
+} material;
+
+layout(location = 0) in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(fragColor, 1.0) * bindlessPalettes[material.palette].colors[material.entry];
+}
\ No newline at end of file
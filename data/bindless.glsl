@@ -0,0 +1,15 @@
+// Global bindless set, see VulkanBindless. Shaders get handles through push constants and index these.
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 3, binding = 0) uniform texture2D bindlessImages[];
+layout(set = 3, binding = 2) uniform sampler bindlessSamplers[];
+
+// Storage buffers need a block type per layout, declare them next to where they are used:
+// layout(set = 3, binding = 1) readonly buffer Materials { Material materials[]; } bindlessMaterials[];
+
+// Handles have to be the same across the draw (push constants), wrap them in nonuniformEXT otherwise and
+// check that the device supports non uniform indexing
+vec4 SampleBindless(uint image, uint sampler, vec2 uv)
+{
+    return texture(sampler2D(bindlessImages[image], bindlessSamplers[sampler]), uv);
+}
\ No newline at end of file
@@ -1,3 +1,8 @@
 C:\VulkanSDK\1.2.198.1\Bin\glslc.exe shader.vert -o vertex.spv
 C:\VulkanSDK\1.2.198.1\Bin\glslc.exe shader.frag -o fragment.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslc.exe bindless.frag -o bindless.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslc.exe instanced.vert -o instanced.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslc.exe drawlist.comp -o drawlist.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslc.exe depthreduce.comp -o depthreduce.spv
+..\binaries\Release\packer.exe data.pak .
 pause
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// Per instance, locations 2-5
+layout(location = 2) in mat4 inTransform;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+};
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = proj * view * inTransform * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "Archive.h"
+
+#include "Common.h"
+
+#include <cstring>
+
+bool Archive::Open(const std::string& fileName)
+{
+	Close();
+
+	if (!File::TryMap(fileName, Mapping))
+		return false;
+
+	const uint8_t* data = Mapping.Data();
+	if (Mapping.Size() < sizeof(ArchiveFormat::Header))
+	{
+		Close();
+		return false;
+	}
+
+	Header = reinterpret_cast<const ArchiveFormat::Header*>(data);
+	Entries = reinterpret_cast<const ArchiveFormat::Entry*>(data + Header->EntriesOffset);
+	Buckets = reinterpret_cast<const uint32_t*>(data + Header->BucketsOffset);
+	Names = reinterpret_cast<const char*>(data + Header->NamesOffset);
+
+	if (!Validate())
+	{
+		LOG_VK("Archive %s is corrupt or from another version", fileName.c_str());
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void Archive::Close()
+{
+	Mapping.Close();
+
+	Header = nullptr;
+	Entries = nullptr;
+	Buckets = nullptr;
+	Names = nullptr;
+}
+
+File::ByteView Archive::Find(const std::string& name) const
+{
+	File::ByteView view;
+	if (Header == nullptr || Header->EntryCount == 0)
+		return view;
+
+	uint64_t hash = ArchiveFormat::Hash(name.data(), name.size());
+	uint32_t mask = Header->BucketCount - 1;
+
+	for (uint32_t bucket = static_cast<uint32_t>(hash) & mask;; bucket = (bucket + 1) & mask)
+	{
+		uint32_t index = Buckets[bucket];
+		if (index == ArchiveFormat::EmptyBucket)
+			return view;
+
+		const ArchiveFormat::Entry& entry = Entries[index];
+		if (entry.NameHash == hash && entry.NameLength == name.size() && std::memcmp(Names + entry.NameOffset, name.data(), name.size()) == 0)
+		{
+			view.Data = Mapping.Data() + entry.Offset;
+			view.Size = static_cast<size_t>(entry.Size);
+			return view;
+		}
+	}
+}
+
+File::ByteView Archive::Get(const std::string& name) const
+{
+	File::ByteView view = Find(name);
+	CRITICAL_ASSERT(view.Data != nullptr, "Asset %s not found in archive", name.c_str());
+
+	return view;
+}
+
+bool Archive::Validate() const
+{
+	// Everything is checked once here so lookups can trust the tables
+	uint64_t size = Mapping.Size();
+
+	if (Header->Magic != ArchiveFormat::Magic || Header->Version != ArchiveFormat::Version)
+		return false;
+
+	if (Header->BucketCount == 0 || (Header->BucketCount & (Header->BucketCount - 1)) != 0 || Header->BucketCount <= Header->EntryCount)
+		return false;
+
+	uint64_t entriesSize = static_cast<uint64_t>(Header->EntryCount) * sizeof(ArchiveFormat::Entry);
+	uint64_t bucketsSize = static_cast<uint64_t>(Header->BucketCount) * sizeof(uint32_t);
+
+	if (Header->EntriesOffset % alignof(ArchiveFormat::Entry) != 0 || Header->BucketsOffset % alignof(uint32_t) != 0)
+		return false;
+
+	if (Header->EntriesOffset > size || entriesSize > size - Header->EntriesOffset ||
+		Header->BucketsOffset > size || bucketsSize > size - Header->BucketsOffset ||
+		Header->NamesOffset > size || Header->NamesSize > size - Header->NamesOffset)
+		return false;
+
+	for (uint32_t i = 0; i < Header->EntryCount; i++)
+	{
+		const ArchiveFormat::Entry& entry = Entries[i];
+		if (static_cast<uint64_t>(entry.NameOffset) + entry.NameLength > Header->NamesSize)
+			return false;
+		if (entry.Offset > size || entry.Size > size - entry.Offset)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < Header->BucketCount; i++)
+	{
+		if (Buckets[i] != ArchiveFormat::EmptyBucket && Buckets[i] >= Header->EntryCount)
+			return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ArchiveFormat.h"
+#include "File.h"
+
+#include <string>
+
+// Read-only .pak archive, mapped once. Lookups don't touch the file system and the returned views
+// point straight into the mapping, so they stay valid as long as the archive is open.
+class Archive
+{
+public:
+	Archive() {}
+
+	bool Open(const std::string& fileName);
+	void Close();
+
+	bool IsOpen() const { return Header != nullptr; }
+	uint32_t GetEntryCount() const { return Header != nullptr ? Header->EntryCount : 0; }
+
+	// Empty view if there is no such asset
+	File::ByteView Find(const std::string& name) const;
+
+	// Aborts if there is no such asset
+	File::ByteView Get(const std::string& name) const;
+
+private:
+	File::MappedFile Mapping;
+
+	const ArchiveFormat::Header* Header = nullptr;
+	const ArchiveFormat::Entry* Entries = nullptr;
+	const uint32_t* Buckets = nullptr;
+	const char* Names = nullptr;
+
+	bool Validate() const;
+};
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// On-disk layout of .pak archives, shared by the runtime and the packer.
+//
+// Header | Entries (sorted by name hash) | Buckets | Names | Blobs (each Alignment aligned)
+//
+// Buckets is an open addressing table (linear probing, power of two size) of entry indices,
+// so a lookup is one hash and usually a single probe. Everything is little endian.
+namespace ArchiveFormat
+{
+	const uint32_t Magic = 0x4B415044; // "DPAK"
+	const uint32_t Version = 1;
+	const uint64_t Alignment = 64; // Covers SPIR-V's 4 bytes and keeps blobs on their own cache lines
+	const uint32_t EmptyBucket = 0xFFFFFFFF;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t BucketCount;
+		uint64_t EntriesOffset;
+		uint64_t BucketsOffset;
+		uint64_t NamesOffset;
+		uint64_t NamesSize;
+	};
+
+	struct Entry
+	{
+		uint64_t NameHash;
+		uint32_t NameOffset; // Into the names block, not null terminated
+		uint32_t NameLength;
+		uint64_t Offset; // From the start of the file
+		uint64_t Size;
+	};
+
+	// FNV-1a, names use forward slashes and are relative to the packed directory
+	inline uint64_t Hash(const char* name, size_t length)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= static_cast<uint8_t>(name[i]);
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	inline uint32_t GetBucketCount(uint32_t entryCount)
+	{
+		// At most half full keeps probe sequences short
+		uint32_t count = 1;
+		while (count < entryCount * 2)
+		{
+			count <<= 1;
+		}
+		return count;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,612 @@
+#include "AsyncLoader.h"
+
+#include "ThreadPool.h"
+#include "File.h"
+#include "CpuProfiler.h"
+#include "Common.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+// Submission queue size, reads in flight are capped at half of it so wake ups always find room
+static const uint32_t RING_ENTRIES = 64;
+
+// Single reads are capped so the result always fits the cqe, larger files continue like a short read
+static const uint64_t MAX_READ = 1u << 30;
+
+#ifdef __linux__
+
+// No liburing dependency, the rings are set up and driven through the raw syscalls
+struct AsyncLoader::IoUring
+{
+	int Descriptor = -1;
+
+	void* SqRing = MAP_FAILED;
+	size_t SqRingSize = 0;
+	void* CqRing = MAP_FAILED;
+	size_t CqRingSize = 0;
+	io_uring_sqe* Sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	size_t SqesSize = 0;
+
+	uint32_t* SqHead = nullptr;
+	uint32_t* SqTail = nullptr;
+	uint32_t* SqArray = nullptr;
+	uint32_t SqMask = 0;
+	uint32_t SqEntries = 0;
+
+	uint32_t* CqHead = nullptr;
+	uint32_t* CqTail = nullptr;
+	io_uring_cqe* Cqes = nullptr;
+	uint32_t CqMask = 0;
+
+	// Both the ring thread and WakeRing submit
+	std::mutex SubmitMutex;
+
+	// Ring thread only
+	uint32_t InFlight = 0;
+
+	// Requires SubmitMutex. Nothing runs with SQPOLL, so the kernel has consumed every entry by the time
+	// io_uring_enter returns and the queue only ever holds what the caller is about to submit.
+	void Push(const io_uring_sqe& sqe)
+	{
+		uint32_t tail = *SqTail;
+		uint32_t index = tail & SqMask;
+
+		Sqes[index] = sqe;
+		SqArray[index] = index;
+
+		__atomic_store_n(SqTail, tail + 1, __ATOMIC_RELEASE);
+	}
+
+	void Submit(uint32_t count)
+	{
+		while (count > 0)
+		{
+			int submitted = Enter(count, 0, 0);
+			if (submitted < 0)
+			{
+				CRITICAL_ASSERT(errno == EINTR || errno == EAGAIN || errno == EBUSY, "io_uring_enter failed: %s", strerror(errno));
+				continue;
+			}
+			count -= static_cast<uint32_t>(submitted);
+		}
+	}
+
+	int Enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter, Descriptor, toSubmit, minComplete, flags, nullptr, 0));
+	}
+};
+
+static io_uring_sqe MakeRead(int descriptor, uint8_t* buffer, uint64_t offset, uint64_t size, void* userData)
+{
+	io_uring_sqe sqe = {};
+	sqe.opcode = IORING_OP_READ;
+	sqe.fd = descriptor;
+	sqe.addr = reinterpret_cast<uint64_t>(buffer + offset);
+	sqe.len = static_cast<uint32_t>(std::min(size - offset, MAX_READ));
+	sqe.off = offset;
+	sqe.user_data = reinterpret_cast<uint64_t>(userData);
+	return sqe;
+}
+
+#else
+
+struct AsyncLoader::IoUring
+{
+};
+
+#endif
+
+AsyncLoader::AsyncLoader(ThreadPool* workers)
+	: Workers(workers)
+{
+	if (CreateRing())
+	{
+		RingThread = std::thread(&AsyncLoader::RingLoop, this);
+		LOG_VK("Async loader: io_uring, %u reads in flight", RING_ENTRIES / 2);
+	}
+	else
+	{
+		CRITICAL_ASSERT(Workers != nullptr, "Async loader needs a thread pool without io_uring");
+		LOG_VK("Async loader: thread pool");
+	}
+}
+
+AsyncLoader::~AsyncLoader()
+{
+	// Nobody is left to take the callbacks, queued requests are dropped and reads in flight are left to land
+	std::vector<Request*> dropped;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+
+		for (std::deque<Request*>& queue : Queues)
+		{
+			for (Request* request : queue)
+			{
+				Live.erase(request->Id);
+				dropped.push_back(request);
+			}
+			queue.clear();
+		}
+
+		for (auto& live : Live)
+		{
+			live.second->Cancelled = true;
+		}
+	}
+
+	for (Request* request : dropped)
+	{
+		delete request;
+	}
+
+	if (Ring)
+	{
+		RingWork.notify_all();
+		RingThread.join();
+		DestroyRing();
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		Idle.wait(lock, [this]() { return Outstanding == 0; });
+	}
+}
+
+LoadRequest AsyncLoader::Load(const std::string& fileName, LoadPriority priority, LoadCallback onComplete)
+{
+	Request* request = new Request();
+	request->FileName = fileName;
+	request->Priority = priority;
+	request->Callback = std::move(onComplete);
+
+	LoadRequest id;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		CRITICAL_ASSERT(!Stopping, "Load after the async loader started shutting down");
+
+		id = NextRequest++;
+		request->Id = id;
+
+		Queues[static_cast<uint32_t>(priority)].push_back(request);
+		Live[id] = request;
+
+		if (!Ring)
+		{
+			Outstanding++;
+		}
+	}
+
+	if (Ring)
+	{
+		// Either the ring thread sees the new request before it blocks or we see it blocked and kick it
+		RingWork.notify_one();
+		if (RingWaiting.load())
+		{
+			WakeRing();
+		}
+	}
+	else
+	{
+		// One job per request, each takes whatever has the highest priority when it runs
+		Workers->Submit([this]() { ReadOnPool(); });
+	}
+
+	return id;
+}
+
+bool AsyncLoader::Cancel(LoadRequest request)
+{
+	Request* queued = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		auto found = Live.find(request);
+		if (found == Live.end())
+			return false;
+
+		Request* live = found->second;
+		live->Cancelled = true;
+
+		// Never started, complete it right away. Reads in flight finish as cancelled when they land.
+		std::deque<Request*>& queue = Queues[static_cast<uint32_t>(live->Priority)];
+		auto position = std::find(queue.begin(), queue.end(), live);
+		if (position != queue.end())
+		{
+			queue.erase(position);
+			queued = live;
+		}
+	}
+
+	if (queued)
+	{
+		Finish(queued, LoadStatus::Cancelled);
+	}
+
+	return true;
+}
+
+void AsyncLoader::Poll()
+{
+	{
+		std::lock_guard<std::mutex> lock(CompletedMutex);
+		Delivering.swap(Completed);
+	}
+
+	if (Delivering.empty())
+		return;
+
+	PROFILE_SCOPE("AsyncLoader::Poll");
+
+	for (Completion& completion : Delivering)
+	{
+		if (completion.Callback)
+		{
+			completion.Callback(completion.Result);
+		}
+	}
+	Delivering.clear();
+}
+
+uint32_t AsyncLoader::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return static_cast<uint32_t>(Live.size());
+}
+
+AsyncLoader::Request* AsyncLoader::PopQueued()
+{
+	for (std::deque<Request*>& queue : Queues)
+	{
+		if (!queue.empty())
+		{
+			Request* request = queue.front();
+			queue.pop_front();
+			return request;
+		}
+	}
+	return nullptr;
+}
+
+void AsyncLoader::Finish(Request* request, LoadStatus status)
+{
+#ifdef __linux__
+	if (request->Descriptor >= 0)
+	{
+		close(request->Descriptor);
+	}
+#endif
+
+	// Cancel flags under the same lock, so once it returned true the callback is guaranteed to see Cancelled
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Live.erase(request->Id);
+		if (request->Cancelled)
+		{
+			status = LoadStatus::Cancelled;
+		}
+	}
+
+	Completion completion;
+	completion.Callback = std::move(request->Callback);
+	completion.Result.Request = request->Id;
+	completion.Result.Status = status;
+	completion.Result.FileName = std::move(request->FileName);
+	if (status == LoadStatus::Completed)
+	{
+		completion.Result.Data = std::move(request->Data);
+	}
+
+	delete request;
+
+	std::lock_guard<std::mutex> lock(CompletedMutex);
+	Completed.push_back(std::move(completion));
+}
+
+void AsyncLoader::ReadOnPool()
+{
+	Request* request;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		request = PopQueued();
+	}
+
+	// Already taken by an earlier job or cancelled
+	if (request)
+	{
+		PROFILE_SCOPE("AsyncLoad");
+
+		bool read = !request->Cancelled && File::TryReadAllBytes(request->FileName, request->Data);
+		Finish(request, read ? LoadStatus::Completed : LoadStatus::Failed);
+	}
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (--Outstanding == 0)
+	{
+		Idle.notify_all();
+	}
+}
+
+bool AsyncLoader::CreateRing()
+{
+#ifdef __linux__
+	io_uring_params params = {};
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = RING_ENTRIES * 2;
+
+	int descriptor = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+	if (descriptor < 0)
+	{
+		LOG_VK("io_uring unavailable (%s)", strerror(errno));
+		return false;
+	}
+
+	// IORING_OP_READ arrived with the same kernel (5.6) as this feature bit
+	if (!(params.features & IORING_FEAT_RW_CUR_POS))
+	{
+		LOG_VK("io_uring is missing IORING_OP_READ");
+		close(descriptor);
+		return false;
+	}
+
+	Ring = new IoUring();
+	Ring->Descriptor = descriptor;
+
+	Ring->SqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	Ring->CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	Ring->SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap)
+	{
+		Ring->SqRingSize = std::max(Ring->SqRingSize, Ring->CqRingSize);
+	}
+
+	Ring->SqRing = mmap(nullptr, Ring->SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_SQ_RING);
+	if (singleMap)
+	{
+		Ring->CqRing = Ring->SqRing;
+	}
+	else if (Ring->SqRing != MAP_FAILED)
+	{
+		Ring->CqRing = mmap(nullptr, Ring->CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_CQ_RING);
+	}
+	if (Ring->CqRing != MAP_FAILED)
+	{
+		Ring->Sqes = static_cast<io_uring_sqe*>(mmap(nullptr, Ring->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_SQES));
+	}
+
+	if (Ring->Sqes == MAP_FAILED)
+	{
+		LOG_VK("Failed to map the io_uring rings (%s)", strerror(errno));
+		DestroyRing();
+		return false;
+	}
+
+	uint8_t* sq = static_cast<uint8_t*>(Ring->SqRing);
+	Ring->SqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+	Ring->SqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+	Ring->SqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+	Ring->SqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+	Ring->SqEntries = params.sq_entries;
+
+	uint8_t* cq = static_cast<uint8_t*>(Ring->CqRing);
+	Ring->CqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+	Ring->CqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+	Ring->Cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	Ring->CqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AsyncLoader::DestroyRing()
+{
+#ifdef __linux__
+	if (!Ring)
+		return;
+
+	if (Ring->Sqes != MAP_FAILED)
+	{
+		munmap(Ring->Sqes, Ring->SqesSize);
+	}
+	if (Ring->CqRing != MAP_FAILED && Ring->CqRing != Ring->SqRing)
+	{
+		munmap(Ring->CqRing, Ring->CqRingSize);
+	}
+	if (Ring->SqRing != MAP_FAILED)
+	{
+		munmap(Ring->SqRing, Ring->SqRingSize);
+	}
+	close(Ring->Descriptor);
+#endif
+
+	delete Ring;
+	Ring = nullptr;
+}
+
+void AsyncLoader::WakeRing()
+{
+#ifdef __linux__
+	// A nop completion is enough to return the ring thread from its wait, one outstanding is plenty
+	if (WakePending.exchange(true))
+		return;
+
+	io_uring_sqe sqe = {};
+	sqe.opcode = IORING_OP_NOP;
+	sqe.user_data = 0;
+
+	std::lock_guard<std::mutex> lock(Ring->SubmitMutex);
+	Ring->Push(sqe);
+	Ring->Submit(1);
+#endif
+}
+
+void AsyncLoader::RingLoop()
+{
+#ifdef __linux__
+	PROFILE_THREAD("IO");
+
+	IoUring* ring = Ring;
+	const uint32_t maxReads = ring->SqEntries / 2;
+
+	std::vector<Request*> batch;
+	std::vector<io_uring_sqe> reads;
+	reads.reserve(maxReads);
+
+	while (true)
+	{
+		batch.clear();
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			if (ring->InFlight == 0)
+			{
+				RingWork.wait(lock, [this]()
+				{
+					return Stopping || !Queues[0].empty() || !Queues[1].empty() || !Queues[2].empty();
+				});
+
+				if (Stopping)
+					break;
+			}
+
+			while (!Stopping && ring->InFlight + batch.size() < maxReads)
+			{
+				Request* request = PopQueued();
+				if (!request)
+					break;
+				batch.push_back(request);
+			}
+		}
+
+		// Opening stays synchronous, the kernel has the data reads in flight for the whole batch at once
+		{
+			PROFILE_SCOPE("AsyncLoader::Open");
+
+			for (Request* request : batch)
+			{
+				request->Descriptor = open(request->FileName.c_str(), O_RDONLY | O_CLOEXEC);
+
+				struct stat status;
+				if (request->Descriptor < 0 || fstat(request->Descriptor, &status) != 0)
+				{
+					Finish(request, LoadStatus::Failed);
+					continue;
+				}
+
+				if (status.st_size == 0)
+				{
+					Finish(request, LoadStatus::Completed);
+					continue;
+				}
+
+				request->Data.resize(static_cast<size_t>(status.st_size));
+				request->Offset = 0;
+				reads.push_back(MakeRead(request->Descriptor, request->Data.data(), 0, request->Data.size(), request));
+			}
+		}
+
+		if (!reads.empty())
+		{
+			std::lock_guard<std::mutex> lock(ring->SubmitMutex);
+			for (const io_uring_sqe& sqe : reads)
+			{
+				ring->Push(sqe);
+			}
+			ring->Submit(static_cast<uint32_t>(reads.size()));
+			ring->InFlight += static_cast<uint32_t>(reads.size());
+			reads.clear();
+		}
+
+		if (ring->InFlight == 0)
+			continue;
+
+		// Block until something lands unless a request came in meanwhile, new ones wake us with a nop
+		RingWaiting.store(true);
+		bool queued;
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			queued = !Queues[0].empty() || !Queues[1].empty() || !Queues[2].empty();
+		}
+		if (!queued)
+		{
+			ring->Enter(0, 1, IORING_ENTER_GETEVENTS);
+		}
+		RingWaiting.store(false);
+
+		uint32_t head = *ring->CqHead;
+		uint32_t tail = __atomic_load_n(ring->CqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			const io_uring_cqe& cqe = ring->Cqes[head & ring->CqMask];
+
+			Request* request = reinterpret_cast<Request*>(cqe.user_data);
+			if (!request)
+			{
+				WakePending.store(false);
+				continue;
+			}
+
+			int result = cqe.res;
+			if (result == -EINTR || result == -EAGAIN)
+			{
+				reads.push_back(MakeRead(request->Descriptor, request->Data.data(), request->Offset, request->Data.size(), request));
+				continue;
+			}
+
+			if (result > 0)
+			{
+				request->Offset += static_cast<uint64_t>(result);
+			}
+
+			// Short read, keep going from where it stopped
+			if (result > 0 && request->Offset < request->Data.size() && !request->Cancelled)
+			{
+				reads.push_back(MakeRead(request->Descriptor, request->Data.data(), request->Offset, request->Data.size(), request));
+				continue;
+			}
+
+			ring->InFlight--;
+
+			if (result < 0)
+			{
+				Finish(request, LoadStatus::Failed);
+			}
+			else
+			{
+				// Hit the end early if the file shrank since we sized the buffer
+				request->Data.resize(static_cast<size_t>(request->Offset));
+				Finish(request, LoadStatus::Completed);
+			}
+		}
+		__atomic_store_n(ring->CqHead, head, __ATOMIC_RELEASE);
+
+		// Short reads and retries go straight back out
+		if (!reads.empty())
+		{
+			std::lock_guard<std::mutex> lock(ring->SubmitMutex);
+			for (const io_uring_sqe& sqe : reads)
+			{
+				ring->Push(sqe);
+			}
+			ring->Submit(static_cast<uint32_t>(reads.size()));
+			reads.clear();
+		}
+	}
+#endif
+}
\ No newline at end of file
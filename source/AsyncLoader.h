@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class ThreadPool;
+
+enum class LoadPriority : uint32_t
+{
+	High,
+	Normal,
+	Low,
+	Count
+};
+
+enum class LoadStatus
+{
+	Completed,
+	Failed,
+	Cancelled
+};
+
+typedef uint64_t LoadRequest; // 0 is never a valid request
+
+struct LoadResult
+{
+	LoadRequest Request = 0;
+	LoadStatus Status = LoadStatus::Failed;
+	std::string FileName;
+	std::vector<uint8_t> Data; // Callbacks may move this out
+};
+
+typedef std::function<void(LoadResult& result)> LoadCallback;
+
+// Reads whole files in the background. Reads go through io_uring in batches where the kernel has it,
+// otherwise they're spread over the thread pool. Higher priorities are always started first.
+// Completions are queued up and delivered on whichever thread calls Poll, once per frame from the main loop.
+class AsyncLoader
+{
+public:
+	AsyncLoader(ThreadPool* workers);
+	~AsyncLoader();
+
+	// Thread safe
+	LoadRequest Load(const std::string& fileName, LoadPriority priority, LoadCallback onComplete);
+
+	// Thread safe. The callback still runs, with LoadStatus::Cancelled, unless the read already
+	// completed, returns false then.
+	bool Cancel(LoadRequest request);
+
+	// Runs the callbacks of everything that finished since the last call
+	void Poll();
+
+	bool UsesIoUring() const { return Ring != nullptr; }
+	uint32_t GetPendingCount();
+
+private:
+	struct Request
+	{
+		LoadRequest Id = 0;
+		std::string FileName;
+		LoadPriority Priority = LoadPriority::Normal;
+		LoadCallback Callback;
+		std::atomic<bool> Cancelled{ false };
+
+		// Read state
+		std::vector<uint8_t> Data;
+		int Descriptor = -1;
+		uint64_t Offset = 0;
+	};
+
+	struct IoUring;
+
+	ThreadPool* Workers;
+	IoUring* Ring = nullptr;
+
+	std::mutex Mutex;
+	std::condition_variable Idle;
+	std::deque<Request*> Queues[static_cast<uint32_t>(LoadPriority::Count)];
+	std::unordered_map<LoadRequest, Request*> Live; // Queued or reading
+	uint64_t NextRequest = 1;
+	uint32_t Outstanding = 0; // Pool jobs or ring submissions that still reference this
+	bool Stopping = false;
+
+	struct Completion
+	{
+		LoadCallback Callback;
+		LoadResult Result;
+	};
+
+	std::mutex CompletedMutex;
+	std::vector<Completion> Completed;
+	std::vector<Completion> Delivering; // Main thread only, swapped with Completed to keep both allocations around
+
+	std::thread RingThread;
+	std::condition_variable RingWork;
+	std::atomic<bool> RingWaiting{ false }; // Ring thread is blocked in the kernel waiting on reads
+	std::atomic<bool> WakePending{ false };
+
+	Request* PopQueued(); // Requires Mutex
+	void Finish(Request* request, LoadStatus status);
+
+	void ReadOnPool();
+
+	bool CreateRing();
+	void DestroyRing();
+	void RingLoop();
+	void WakeRing();
+};
\ No newline at end of file
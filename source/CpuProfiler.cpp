@@ -0,0 +1,233 @@
+#include "CpuProfiler.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+struct ProfileEvent
+{
+	const char* Name;
+	int64_t Start;
+	int64_t End;
+};
+
+static const uint32_t BUFFER_SIZE = 16384; // Events per thread between two drains, has to be a power of two
+static const uint32_t HISTORY_SIZE = 4096; // Frames kept for the percentiles
+
+// Single producer (owning thread), single consumer (EndFrame) ring
+struct ThreadBuffer
+{
+	uint32_t Thread = 0;
+	ProfileEvent Events[BUFFER_SIZE];
+	std::atomic<uint32_t> Head{ 0 };
+	std::atomic<uint32_t> Tail{ 0 };
+	std::atomic<uint32_t> Dropped{ 0 };
+};
+
+struct ZoneStats
+{
+	const char* Name = nullptr;
+	int64_t FrameTime = 0; // Accumulated over the frame being drained
+	uint32_t FrameCalls = 0;
+	uint64_t TotalCalls = 0;
+	std::vector<float> History; // Milliseconds per frame, ring of HISTORY_SIZE
+	uint32_t Next = 0;
+};
+
+// Only registration and draining lock, recording never does.
+// Buffers outlive their threads so events recorded right before a thread exits still get drained.
+static std::mutex ThreadsMutex;
+static std::vector<ThreadBuffer*> Threads;
+static uint32_t NextThread = Trace::MainThread;
+static thread_local ThreadBuffer* LocalBuffer = nullptr;
+
+// Main thread only
+static std::vector<ZoneStats> Zones;
+static uint64_t FrameIndex = 0;
+static int64_t FrameStart = 0;
+static uint64_t DroppedEvents = 0;
+
+static void Accumulate(const char* name, int64_t duration)
+{
+	ZoneStats* stats = nullptr;
+	for (ZoneStats& zone : Zones)
+	{
+		// The same literal can have a different address in every translation unit
+		if (zone.Name == name || std::strcmp(zone.Name, name) == 0)
+		{
+			stats = &zone;
+			break;
+		}
+	}
+
+	if (stats == nullptr)
+	{
+		Zones.emplace_back();
+		stats = &Zones.back();
+		stats->Name = name;
+	}
+
+	stats->FrameTime += duration;
+	stats->FrameCalls++;
+	stats->TotalCalls++;
+}
+
+static float Percentile(std::vector<float>& values, double percentile)
+{
+	size_t index = static_cast<size_t>(percentile * (values.size() - 1) + 0.5);
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+void CpuProfiler::RegisterThread(const char* name)
+{
+	if (LocalBuffer == nullptr)
+	{
+		ThreadBuffer* buffer = new ThreadBuffer();
+
+		std::lock_guard<std::mutex> lock(ThreadsMutex);
+		buffer->Thread = NextThread++;
+		Threads.push_back(buffer);
+
+		LocalBuffer = buffer;
+	}
+
+	if (name != nullptr)
+	{
+		Trace::SetThreadName(LocalBuffer->Thread, name);
+	}
+	else
+	{
+		std::string fallback = "Thread " + std::to_string(LocalBuffer->Thread);
+		Trace::SetThreadName(LocalBuffer->Thread, fallback.c_str());
+	}
+}
+
+void CpuProfiler::Record(const char* name, int64_t start, int64_t end)
+{
+	if (LocalBuffer == nullptr)
+	{
+		RegisterThread(nullptr);
+	}
+
+	ThreadBuffer* buffer = LocalBuffer;
+
+	uint32_t head = buffer->Head.load(std::memory_order_relaxed);
+	if (head - buffer->Tail.load(std::memory_order_acquire) >= BUFFER_SIZE)
+	{
+		buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ProfileEvent& event = buffer->Events[head & (BUFFER_SIZE - 1)];
+	event.Name = name;
+	event.Start = start;
+	event.End = end;
+
+	buffer->Head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::EndFrame()
+{
+	int64_t now = Trace::Now();
+	bool tracing = Trace::IsOpen();
+
+	{
+		std::lock_guard<std::mutex> lock(ThreadsMutex);
+		for (ThreadBuffer* buffer : Threads)
+		{
+			uint32_t head = buffer->Head.load(std::memory_order_acquire);
+			uint32_t tail = buffer->Tail.load(std::memory_order_relaxed);
+
+			for (; tail != head; tail++)
+			{
+				const ProfileEvent& event = buffer->Events[tail & (BUFFER_SIZE - 1)];
+				Accumulate(event.Name, event.End - event.Start);
+
+				if (tracing)
+				{
+					Trace::Complete(event.Name, buffer->Thread, event.Start, event.End);
+				}
+			}
+
+			buffer->Tail.store(tail, std::memory_order_release);
+			DroppedEvents += buffer->Dropped.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	if (FrameStart != 0)
+	{
+		Accumulate("Frame", now - FrameStart);
+		if (tracing)
+		{
+			Trace::Complete("Frame", Trace::MainThread, FrameStart, now);
+		}
+	}
+	FrameStart = now;
+
+	// Zones that didn't run this frame still cost 0ms in it
+	for (ZoneStats& zone : Zones)
+	{
+		float milliseconds = zone.FrameTime / 1000000.0f;
+		if (zone.History.size() < HISTORY_SIZE)
+		{
+			zone.History.push_back(milliseconds);
+		}
+		else
+		{
+			zone.History[zone.Next] = milliseconds;
+		}
+		zone.Next = (zone.Next + 1) % HISTORY_SIZE;
+
+		zone.FrameTime = 0;
+		zone.FrameCalls = 0;
+	}
+
+	FrameIndex++;
+}
+
+void CpuProfiler::PrintReport()
+{
+	if (Zones.empty())
+		return;
+
+	struct Row
+	{
+		const char* Name;
+		double Calls;
+		float P50, P95, P99;
+	};
+
+	std::vector<Row> rows;
+	std::vector<float> values;
+	for (const ZoneStats& zone : Zones)
+	{
+		values = zone.History;
+
+		Row row;
+		row.Name = zone.Name;
+		row.Calls = static_cast<double>(zone.TotalCalls) / FrameIndex;
+		row.P50 = Percentile(values, 0.50);
+		row.P95 = Percentile(values, 0.95);
+		row.P99 = Percentile(values, 0.99);
+		rows.push_back(row);
+	}
+
+	std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.P50 > b.P50; });
+
+	std::printf("CPU zones, ms per frame over the last %u frames\n", static_cast<uint32_t>(std::min<uint64_t>(FrameIndex, HISTORY_SIZE)));
+	std::printf("%-24s %10s %10s %10s %10s\n", "zone", "calls", "p50", "p95", "p99");
+	for (const Row& row : rows)
+	{
+		std::printf("%-24s %10.2f %10.3f %10.3f %10.3f\n", row.Name, row.Calls, row.P50, row.P95, row.P99);
+	}
+
+	if (DroppedEvents > 0)
+	{
+		std::printf("%llu events dropped, EndFrame isn't called often enough\n", static_cast<unsigned long long>(DroppedEvents));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Trace.h"
+
+#include <cstdint>
+
+// Compiled in for debug builds, define DAEDALUS_PROFILE=1 to profile release builds
+#ifndef DAEDALUS_PROFILE
+#ifdef NDEBUG
+#define DAEDALUS_PROFILE 0
+#else
+#define DAEDALUS_PROFILE 1
+#endif
+#endif
+
+// Opt in for release builds that should still put CPU zones in a --trace, at the cost of a flag check per zone
+#ifndef DAEDALUS_TRACE_ZONES
+#define DAEDALUS_TRACE_ZONES 0
+#endif
+
+// Scoped CPU zones. Every thread writes into its own ring buffer without locking, the main thread drains
+// all of them once per frame in EndFrame, aggregates per zone and forwards the events to the trace.
+namespace CpuProfiler
+{
+	// Optional, threads register themselves on their first zone otherwise
+	void RegisterThread(const char* name);
+
+	// Name has to be a string literal or otherwise outlive the profiler
+	void Record(const char* name, int64_t start, int64_t end);
+
+	// Main thread, once per frame
+	void EndFrame();
+
+	// Per zone time spent per frame (p50/p95/p99) over the recorded history
+	void PrintReport();
+
+	class Scope
+	{
+	public:
+		Scope(const char* name)
+			: Name(name), Start(Trace::Now())
+		{
+		}
+
+		~Scope()
+		{
+			Record(Name, Start, Trace::Now());
+		}
+
+	private:
+		const char* Name;
+		int64_t Start;
+	};
+
+	// DAEDALUS_TRACE_ZONES builds, only records while a trace is open
+	class TraceScope
+	{
+	public:
+		TraceScope(const char* name)
+			: Name(name), Active(Trace::IsOpen()), Start(Active ? Trace::Now() : 0)
+		{
+		}
+
+		~TraceScope()
+		{
+			if (Active)
+			{
+				Record(Name, Start, Trace::Now());
+			}
+		}
+
+	private:
+		const char* Name;
+		bool Active;
+		int64_t Start;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if DAEDALUS_PROFILE
+#define PROFILE_SCOPE(name) CpuProfiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) CpuProfiler::RegisterThread(name)
+#define PROFILE_FRAME() CpuProfiler::EndFrame()
+#elif DAEDALUS_TRACE_ZONES
+#define PROFILE_SCOPE(name) CpuProfiler::TraceScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) CpuProfiler::RegisterThread(name)
+#define PROFILE_FRAME() CpuProfiler::EndFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
\ No newline at end of file
@@ -6,47 +6,172 @@
 #include "Common.h"
 #include "VulkanSwapChain.h"
 #include "VulkanDevice.h"
+#include "Trace.h"
+#include "CpuProfiler.h"
 
-Engine::Engine()
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+
+Engine::Engine(const EngineConfig& config)
+	: Config(config)
 {
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0)
+	winWidth = Config.Width;
+	winHeight = Config.Height;
+
+	if (Config.TracePath != nullptr)
 	{
-		return;
+		if (!Trace::Open(Config.TracePath))
+		{
+			std::cout << "Failed to open trace " << Config.TracePath << "\n";
+		}
+#if !DAEDALUS_PROFILE && !DAEDALUS_TRACE_ZONES
+		std::cout << "CPU zones are compiled out, the trace only has GPU zones (define DAEDALUS_TRACE_ZONES=1 to keep them)\n";
+#endif
 	}
 
-	Window = SDL_CreateWindow(
-		"Hello World",
-		SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-		1280, 720,
-		SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE
-	);
+	// First thread to register, so it gets Trace::MainThread
+	PROFILE_THREAD("Main");
+
+	NewDevice = new VulkanDevice();
+	NewDevice->SetPresentProfile(Config.Profile, Config.FramesAhead, Config.ImageCount);
+	NewDevice->Swapchain.UseDepth = Config.Objects > 0; // Only the draw list's pipeline and culling use depth
 
-	if (Window == nullptr)
+	if (Config.Headless)
 	{
-		return;
+		NewDevice->InitializeHeadless(winWidth, winHeight);
 	}
+	else
+	{
+		if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0)
+		{
+			return;
+		}
 
-	NewDevice = new VulkanDevice();
-	NewDevice->Initialize(Window);
+		Window = SDL_CreateWindow(
+			"Hello World",
+			SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+			winWidth, winHeight,
+			SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE
+		);
+
+		if (Window == nullptr)
+		{
+			return;
+		}
 
-	NewShader = VulkanShader::CreateFromSPIRV(File::ReadAllBytes("data/vertex.spv"), File::ReadAllBytes("data/fragment.spv"));
+		NewDevice->Initialize(Window);
+	}
+
+	Workers = new ThreadPool();
+	NewDevice->Pipelines.Workers = Workers;
+	Loader = new AsyncLoader(Workers);
+	if (Config.ParallelRecording)
+	{
+		// One extra pool for the main thread, which helps out in ParallelFor
+		NewDevice->CreateWorkerPools(Workers->GetThreadCount() + 1);
+		NewDevice->ParallelRecording = true;
+	}
 
-	std::vector<VertexAttribute> attribz =
+	// Instanced variant reads a mat4 per instance from binding 1, draw lists feed it too
+	bool instanced = Config.Instances > 0 || Config.Objects > 0;
+	const char* vertexShader = instanced ? "instanced.spv" : "vertex.spv";
+
+	if (Config.Bindless && !NewDevice->Bindless.IsAvailable())
 	{
-		{ AttributeType::Float2, 2, sizeof(float) * 2, 0 },
-		{ AttributeType::Float3, 3, sizeof(float) * 3, 2 * sizeof(float) }
-	};
-	NewPipeline = VulkanPipeline::Create(NewDevice, NewShader, attribz, sizeof(Vertex));
+		std::cout << "Bindless set not available, using the plain fragment shader\n";
+		Config.Bindless = false;
+	}
+	const char* fragmentShader = Config.Bindless ? "bindless.spv" : "fragment.spv";
 
-	Vb = VulkanBuffer::Create(NewDevice, BufferType::Vertex, vertices.data(), vertices.size() * sizeof(Engine::Vertex));
-	Ib = VulkanBuffer::Create(NewDevice, BufferType::Index, indices.data(), indices.size() * sizeof(uint16_t));
+	bool packed = Assets.Open("data/data.pak");
+	if (packed)
+	{
+		std::cout << "Loading assets from data/data.pak (" << Assets.GetEntryCount() << " entries)\n";
+		NewShader = VulkanShader::CreateFromSPIRV(Assets.Get(vertexShader), Assets.Get(fragmentShader));
+	}
+	else
+	{
+		NewShader = VulkanShader::CreateFromSPIRV(File::Map((std::string("data/") + vertexShader).c_str()), File::Map((std::string("data/") + fragmentShader).c_str()));
+	}
+
+	PipelineDescription pipelineDescription;
+	pipelineDescription.Shader = NewShader;
+	pipelineDescription.VertexFormats[0] = AttributeType::Half2;
+	pipelineDescription.VertexFormats[1] = AttributeType::Unorm8x4;
+	if (instanced)
+	{
+		pipelineDescription.InstanceInputs = 0xF << 2; // inTransform columns
+		pipelineDescription.DynamicSets = 1 << 0; // Camera from the frame allocator
+	}
+	if (Config.Objects > 0)
+	{
+		// Occlusion culling reads back what the pass wrote
+		pipelineDescription.DepthTest = true;
+		pipelineDescription.DepthWrite = true;
+	}
+
+	NewPipeline = NewDevice->Pipelines.GetAsync(pipelineDescription, [](VulkanPipeline* pipeline)
+	{
+		CRITICAL_ASSERT(pipeline->VertexStride == sizeof(Vertex), "Vertex struct doesn't match the vertex shader inputs");
+	});
+
+	Quad = NewDevice->Geometry.Allocate(vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(Vertex), indices.data(), static_cast<uint32_t>(indices.size()));
+
+	if (Config.Bindless)
+	{
+		// Shaders find it through the handle in their push constants, no set of its own
+		Palette = VulkanBuffer::Create(NewDevice, BufferType::Storage, paletteColors.data(), paletteColors.size() * sizeof(glm::vec4));
+		PaletteHandle = NewDevice->Bindless.AddBuffer(Palette->Buffer);
+	}
+
+	if (Config.Objects > 0)
+	{
+		// Only needed during creation, the mappings can go right away
+		File::MappedFile buildFile;
+		File::MappedFile reduceFile;
+		File::ByteView buildShader;
+		File::ByteView reduceShader;
+		if (packed)
+		{
+			buildShader = Assets.Get("drawlist.spv");
+			reduceShader = Assets.Get("depthreduce.spv");
+		}
+		else
+		{
+			buildFile = File::Map("data/drawlist.spv");
+			buildShader = buildFile.View();
+			reduceFile = File::Map("data/depthreduce.spv");
+			reduceShader = reduceFile.View();
+		}
+		Pyramid = VulkanDepthPyramid::Create(NewDevice, reduceShader);
+		DrawList = VulkanDrawList::Create(NewDevice, buildShader, Config.Objects, Pyramid);
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> depth(0.05f, 0.95f);
+		std::uniform_real_distribution<float> scale(0.005f, 0.02f);
+
+		for (uint32_t i = 0; i < Config.Objects; i++)
+		{
+			glm::mat4 transform(scale(random));
+			transform[2][2] = 1.0f;
+			transform[3] = glm::vec4(position(random), position(random), depth(random), 1.0f);
+			DrawList->Add(Quad, transform, glm::vec3(0.0f), 0.7072f); // Unit quad's corners
+		}
+	}
 
 	std::cout << "Main loop started\n";
 
+	uint32_t frameCount = 0;
+	auto startTime = std::chrono::steady_clock::now();
+
 	SDL_Event event;
 	while (true)
 	{
-		if (SDL_PollEvent(&event))
+		if (!Config.Headless && SDL_PollEvent(&event))
 		{
 			if (event.type == SDL_QUIT)
 			{
@@ -59,19 +184,53 @@ Engine::Engine()
 					std::cout << "resize \n";
 					winWidth = event.window.data1;
 					winHeight = event.window.data2;
+					NewDevice->Resize();
 				}
 			}
 		}
 
+		Loader->Poll();
+
+		Time = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+
 		Render();
+		PROFILE_FRAME();
+
+		frameCount++;
+		if (Config.FrameLimit != 0 && frameCount >= Config.FrameLimit)
+		{
+			break;
+		}
 	}
 
 	// TODO: !!! do this elsewhere ???
 	vkDeviceWaitIdle(NewDevice->Device);
 
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+	std::cout << frameCount << " frames in " << elapsed.count() << "s ("
+		<< (frameCount / elapsed.count()) << " fps)\n";
+
+	VulkanRenderQueue::Statistics queue = NewDevice->RenderQueue.GetStatistics();
+	std::cout << "Last frame: " << queue.Draws << " draws, " << queue.PipelineBinds << " pipeline binds, "
+		<< queue.SetBinds << " set binds, " << queue.BufferBinds << " buffer binds, " << queue.Pushes << " pushes\n";
+
+	if (NewDevice->Profiler.ResolvedFrames > 0)
+	{
+		// GPU time close to the CPU frame time means we are GPU bound
+		std::cout << "GPU frame " << NewDevice->Profiler.AverageGpuFrameTime << "ms avg, CPU frame "
+			<< (elapsed.count() * 1000.0 / frameCount) << "ms avg\n";
+	}
+
+#if DAEDALUS_PROFILE
+	CpuProfiler::PrintReport();
+#endif
+
 	Cleanup();
 
-	SDL_DestroyWindow(Window);
+	if (Window != nullptr)
+	{
+		SDL_DestroyWindow(Window);
+	}
 	SDL_Quit();
 }
 
@@ -81,16 +240,167 @@ void Engine::Initialize()
 
 void Engine::Cleanup()
 {
+	NewDevice->Pipelines.WaitAll();
+	NewDevice->Pipelines.Workers = nullptr;
+
+	if (DrawList != nullptr)
+	{
+		VulkanDrawList::Destroy(NewDevice, DrawList);
+		DrawList = nullptr;
+	}
+
+	if (Pyramid != nullptr)
+	{
+		VulkanDepthPyramid::Destroy(NewDevice, Pyramid);
+		Pyramid = nullptr;
+	}
+
+	if (Palette != nullptr)
+	{
+		NewDevice->Bindless.Remove(BindlessType::Buffer, PaletteHandle);
+		VulkanBuffer::Destroy(NewDevice, Palette);
+		Palette = nullptr;
+	}
+
+	// Falls back to the pool, has to go first
+	delete Loader;
+	Loader = nullptr;
+
+	delete Workers;
+	Workers = nullptr;
+
+	NewDevice->Shutdown();
+
+	Trace::Close();
 }
 
 void Engine::Render()
 {
-	NewDevice->BeginFrame(Vb->Buffer, Ib->Buffer, indices.size(), NewPipeline);
+	if (!NewDevice->BeginFrame())
+	{
+		SDL_Delay(10); // Minimized, don't spin
+		return;
+	}
+
+	// Slow pan, so culling has something to catch up with
+	CameraBuffer camera;
+	camera.model = glm::mat4(1.0f);
+	camera.view = glm::mat4(1.0f);
+	camera.view[3][0] = 0.25f * std::sin(Time * 0.5f);
+	camera.proj = glm::mat4(1.0f);
+	ViewProj = camera.proj * camera.view;
+
+	bool instanced = Config.Instances > 0 || Config.Objects > 0;
+	if (instanced)
+	{
+		CameraData = NewDevice->FrameAllocator.Push(camera);
+	}
+
+	if (Palette != nullptr)
+	{
+		// Next palette entry every second
+		Material[0] = PaletteHandle;
+		Material[1] = static_cast<uint32_t>(Time) % static_cast<uint32_t>(paletteColors.size());
+	}
+
+	if (DrawList != nullptr)
+	{
+		Pyramid->Build();
+		DrawList->Build(ViewProj);
+	}
+
+	SubmitDraws();
+	NewDevice->RenderQueue.Sort();
 
-	NewDevice->BindVertexBuffer(Vb);
-	NewDevice->BindIndexBuffer(Ib);
+	NewDevice->BeginMainPass();
 
-	NewDevice->DrawIndexed(indices.size());
+	uint32_t packetCount = NewDevice->RenderQueue.GetPacketCount();
+	if (Config.ParallelRecording)
+	{
+		// One range of the sorted packets per thread, the range index keeps the secondaries in sorted order
+		PROFILE_SCOPE("Record");
+		Workers->ParallelRanges(packetCount, [this](uint32_t first, uint32_t count, uint32_t index, uint32_t worker)
+		{
+			PROFILE_SCOPE("RecordSecondary");
+			NewDevice->BeginSecondary(worker, index);
+			RecordDraws(first, count);
+			NewDevice->EndSecondary();
+		});
+	}
+	else
+	{
+		PROFILE_SCOPE("Record");
+		RecordDraws(0, packetCount);
+	}
 
 	NewDevice->Present();
 }
+
+void Engine::SubmitDraws()
+{
+	VulkanPipeline* pipeline = NewPipeline.Get();
+	if (pipeline == nullptr || DrawList != nullptr)
+		return; // Still compiling, or the draw list covers everything
+
+	RenderPacket packet;
+	packet.Pipeline = pipeline;
+	packet.Uniforms = CameraData;
+	packet.Geometry = Quad;
+
+	if (pipeline->UsesBindless)
+	{
+		memcpy(packet.PushConstants, Material, sizeof(Material));
+		packet.PushConstantSize = sizeof(Material);
+	}
+
+	if (Config.Instances == 0)
+	{
+		NewDevice->RenderQueue.Submit(packet);
+		return;
+	}
+
+	// Square grid filling the screen, every quad spins at its own rate
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(Config.Instances))));
+	float cell = 2.0f / side;
+
+	std::vector<glm::mat4> transforms(Config.Instances);
+	for (uint32_t i = 0; i < Config.Instances; i++)
+	{
+		float angle = Time * (1.0f + 0.1f * (i % 7));
+		float scale = cell * 0.8f;
+		float c = std::cos(angle) * scale;
+		float s = std::sin(angle) * scale;
+
+		glm::mat4& transform = transforms[i];
+		transform = glm::mat4(1.0f);
+		transform[0][0] = c;
+		transform[0][1] = s;
+		transform[1][0] = -s;
+		transform[1][1] = c;
+		transform[3][0] = -1.0f + cell * (i % side + 0.5f);
+		transform[3][1] = -1.0f + cell * (i / side + 0.5f);
+	}
+
+	packet.Instances = NewDevice->FrameAllocator.PushArray(transforms.data(), transforms.size());
+	packet.InstanceCount = Config.Instances;
+	NewDevice->RenderQueue.Submit(packet);
+}
+
+void Engine::RecordDraws(uint32_t first, uint32_t count)
+{
+	NewDevice->RenderQueue.Execute(first, count);
+
+	VulkanPipeline* pipeline = NewPipeline.Get();
+	if (DrawList == nullptr || pipeline == nullptr || first > 0)
+		return;
+
+	// Binds its own buffers, nothing of the queue's state carries over
+	NewDevice->BindPipeline(pipeline);
+	NewDevice->BindFrameAllocation(pipeline, 0, CameraData);
+	if (pipeline->UsesBindless)
+	{
+		NewDevice->BindBindless(pipeline);
+		NewDevice->PushConstants(pipeline, Material, sizeof(Material));
+	}
+	DrawList->Draw();
+}
\ No newline at end of file
@@ -12,11 +12,34 @@
 #include "VulkanDevice.h"
 #include "VulkanBuffer.h"
 #include "VulkanPipeline.h"
+#include "ThreadPool.h"
+#include "AsyncLoader.h"
+#include "Archive.h"
+#include "VulkanDrawList.h"
+#include "VulkanDepthPyramid.h"
+
+struct EngineConfig
+{
+	bool Headless = false; // Render offscreen without a window, for benchmarking
+	uint32_t Width = 1280;
+	uint32_t Height = 720;
+	uint32_t FrameLimit = 0; // 0 runs until the window is closed
+	bool ParallelRecording = false; // Record draws on worker threads into secondary command buffers
+	PresentProfile Profile = PresentProfile::MaxThroughput;
+	uint32_t FramesAhead = 0; // 0 uses the profile's default
+	uint32_t ImageCount = 0; // 0 uses the present mode's default
+	const char* TracePath = nullptr; // Chrome trace of CPU and GPU zones, off if null
+	uint32_t Instances = 0; // Draws a grid of instanced quads with streamed transforms, 0 draws the single quad
+	uint32_t Objects = 0; // Scatters this many quads into a GPU built draw list instead
+	bool Bindless = false; // Tints the quads from a palette read through the bindless set, needs descriptor indexing
+};
 
 class Engine
 {
 public:
-	Engine();
+	Engine(const EngineConfig& config = EngineConfig());
+
+	EngineConfig Config;
 
 	SDL_Window* Window = nullptr;
 
@@ -25,29 +48,61 @@ public:
 
 	VulkanDevice* NewDevice;
 
-	VulkanBuffer* Vb;
-	VulkanBuffer* Ib;
+	GeometryHandle Quad;
+
+	// Objects drawn through one indirect call, null unless Config.Objects is set
+	VulkanDrawList* DrawList = nullptr;
+	VulkanDepthPyramid* Pyramid = nullptr; // Occlusion culling for the draw list
+
+	// Storage buffer in the bindless set, null unless Config.Bindless is set
+	VulkanBuffer* Palette = nullptr;
+	uint32_t PaletteHandle = VulkanBindless::INVALID_HANDLE;
 	
 	VulkanShader* NewShader;
 
-	VulkanPipeline* NewPipeline;
+	PipelineHandle NewPipeline; // Compiles in the background, draws are skipped until it's ready
+
+	ThreadPool* Workers = nullptr;
+
+	// Streaming reads, completions are delivered at the top of every frame
+	AsyncLoader* Loader = nullptr;
 
+	// data/data.pak when it exists, loose files under data/ otherwise
+	Archive Assets;
+
+	// 8 bytes instead of 20, the shader still sees a vec2 and a vec3
 	struct Vertex {
-		glm::vec2 pos;
-		glm::vec3 color;
+		uint16_t pos[2]; // AttributeType::Half2
+		uint32_t color; // AttributeType::Unorm8x4
+
+		static Vertex Pack(float x, float y, float r, float g, float b)
+		{
+			Vertex vertex;
+			vertex.pos[0] = VertexFormat::EncodeHalf(x);
+			vertex.pos[1] = VertexFormat::EncodeHalf(y);
+			vertex.color = VertexFormat::PackUnorm8x4(r, g, b, 1.0f);
+			return vertex;
+		}
 	};
 
 	const std::vector<Vertex> vertices = {
-		{{-0.5f, -0.5f}, {1.0f, 0.47f, 0.0f}},
-		{{0.5f, -0.5f}, {1.0f, 0.45f, 0.0f}},
-		{{0.5f, 0.5f}, {1.0f, 0.35f, 0.0f}},
-		{{-0.5f, 0.5f}, {1.0f, 0.37f, 0.0f}}
+		Vertex::Pack(-0.5f, -0.5f, 1.0f, 0.47f, 0.0f),
+		Vertex::Pack(0.5f, -0.5f, 1.0f, 0.45f, 0.0f),
+		Vertex::Pack(0.5f, 0.5f, 1.0f, 0.35f, 0.0f),
+		Vertex::Pack(-0.5f, 0.5f, 1.0f, 0.37f, 0.0f)
 	};
 
 	const std::vector<uint16_t> indices = {
 		0, 1, 2, 2, 3, 0
 	};
 
+	const std::vector<glm::vec4> paletteColors = {
+		glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+		glm::vec4(1.0f, 0.4f, 0.4f, 1.0f),
+		glm::vec4(0.4f, 1.0f, 0.4f, 1.0f),
+		glm::vec4(0.6f, 0.6f, 1.0f, 1.0f)
+	};
+
 	struct CameraBuffer {
 		glm::mat4 model;
 		glm::mat4 view;
@@ -58,5 +113,19 @@ private:
 	void Initialize();
 	void Cleanup();
 
+	// Seconds since the main loop started, animates the instances
+	float Time = 0.0f;
+
+	// This frame's CameraBuffer, set 0 of the instanced pipeline
+	FrameAllocation CameraData;
+	glm::mat4 ViewProj = glm::mat4(1.0f);
+
+	// This frame's push constants for bindless.spv: PaletteHandle and the palette entry
+	uint32_t Material[2] = {};
+
 	void Render();
+	// Fills the device's render queue, main thread
+	void SubmitDraws();
+	// Records a range of the sorted queue, the first range also draws the draw list. Any thread.
+	void RecordDraws(uint32_t first, uint32_t count);
 };
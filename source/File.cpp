@@ -1,5 +1,16 @@
 #include "File.h"
 #include <fstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "Common.h"
 
@@ -18,4 +29,207 @@ std::vector<uint8_t> File::ReadAllBytes(const std::string& fileName)
 	file.close();
 
 	return buffer;
+}
+
+bool File::TryReadAllBytes(const std::string& fileName, std::vector<uint8_t>& bytes)
+{
+	std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	bytes.resize(fileSize);
+
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(bytes.data()), fileSize);
+
+	return static_cast<bool>(file);
+}
+
+bool File::WriteAllBytesAtomic(const std::string& fileName, const void* data, size_t size)
+{
+	std::string tempName = fileName + ".tmp";
+
+	{
+		std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(data), size);
+		file.flush();
+		if (!file)
+		{
+			file.close();
+			std::remove(tempName.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	// std::rename refuses to replace an existing file on Windows
+	bool renamed = MoveFileExA(tempName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = std::rename(tempName.c_str(), fileName.c_str()) == 0;
+#endif
+
+	if (!renamed)
+	{
+		std::remove(tempName.c_str());
+	}
+
+	return renamed;
+}
+
+File::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+File::MappedFile::MappedFile(MappedFile&& other)
+{
+	*this = std::move(other);
+}
+
+File::MappedFile& File::MappedFile::operator=(MappedFile&& other)
+{
+	if (this != &other)
+	{
+		Close();
+
+		Mapped = other.Mapped;
+		Length = other.Length;
+		Opened = other.Opened;
+#ifdef _WIN32
+		FileHandle = other.FileHandle;
+		MappingHandle = other.MappingHandle;
+		other.FileHandle = nullptr;
+		other.MappingHandle = nullptr;
+#endif
+		other.Mapped = nullptr;
+		other.Length = 0;
+		other.Opened = false;
+	}
+
+	return *this;
+}
+
+void File::MappedFile::Close()
+{
+#ifdef _WIN32
+	if (Mapped != nullptr)
+	{
+		UnmapViewOfFile(Mapped);
+	}
+	if (MappingHandle != nullptr)
+	{
+		CloseHandle(MappingHandle);
+	}
+	if (FileHandle != nullptr)
+	{
+		CloseHandle(FileHandle);
+	}
+	FileHandle = nullptr;
+	MappingHandle = nullptr;
+#else
+	if (Mapped != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(Mapped), Length);
+	}
+#endif
+
+	Mapped = nullptr;
+	Length = 0;
+	Opened = false;
+}
+
+File::MappedFile File::Map(const std::string& fileName)
+{
+	MappedFile file;
+	bool mapped = TryMap(fileName, file);
+	CRITICAL_ASSERT(mapped, "Failed to map file %s", fileName.c_str());
+
+	return file;
+}
+
+bool File::TryMap(const std::string& fileName, MappedFile& file)
+{
+	file.Close();
+
+	// Empty files can't be mapped, they open fine with a null view instead
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size))
+	{
+		CloseHandle(handle);
+		return false;
+	}
+
+	file.FileHandle = handle;
+	file.Opened = true;
+
+	if (size.QuadPart == 0)
+	{
+		return true;
+	}
+
+	file.MappingHandle = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (file.MappingHandle == nullptr)
+	{
+		file.Close();
+		return false;
+	}
+
+	file.Mapped = static_cast<const uint8_t*>(MapViewOfFile(file.MappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (file.Mapped == nullptr)
+	{
+		file.Close();
+		return false;
+	}
+
+	file.Length = static_cast<size_t>(size.QuadPart);
+#else
+	int descriptor = open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(descriptor, &info) != 0)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	file.Opened = true;
+
+	if (info.st_size > 0)
+	{
+		void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(descriptor);
+			file.Close();
+			return false;
+		}
+
+		file.Mapped = static_cast<const uint8_t*>(mapped);
+		file.Length = static_cast<size_t>(info.st_size);
+	}
+
+	// The mapping keeps the file referenced on its own
+	close(descriptor);
+#endif
+
+	return true;
 }
\ No newline at end of file
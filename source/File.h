@@ -2,8 +2,60 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 namespace File
 {
+	// Non-owning, read-only view over bytes, whoever handed it out keeps the memory alive
+	struct ByteView
+	{
+		const uint8_t* Data = nullptr;
+		size_t Size = 0;
+
+		bool Empty() const { return Size == 0; }
+	};
+
+	// Read-only memory mapping of a whole file, unmapped on destruction. Pages are only read in
+	// when touched and are shared with the OS file cache, so nothing is copied into the process.
+	class MappedFile
+	{
+	public:
+		MappedFile() {}
+		~MappedFile();
+
+		MappedFile(MappedFile&& other);
+		MappedFile& operator=(MappedFile&& other);
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool IsOpen() const { return Opened; }
+		const uint8_t* Data() const { return Mapped; }
+		size_t Size() const { return Length; }
+		ByteView View() const { return ByteView{ Mapped, Length }; }
+
+		void Close();
+
+	private:
+		friend bool TryMap(const std::string& fileName, MappedFile& file);
+
+		const uint8_t* Mapped = nullptr;
+		size_t Length = 0;
+		bool Opened = false;
+#ifdef _WIN32
+		void* FileHandle = nullptr;
+		void* MappingHandle = nullptr;
+#endif
+	};
+
+	MappedFile Map(const std::string& fileName);
+	bool TryMap(const std::string& fileName, MappedFile& file);
+
 	std::vector<uint8_t> ReadAllBytes(const std::string& fileName);
+
+	// Soft variant for optional files (caches etc.), returns false instead of aborting
+	bool TryReadAllBytes(const std::string& fileName, std::vector<uint8_t>& bytes);
+
+	// Writes to a temporary file first and renames it over the target, so readers never see a partial file
+	bool WriteAllBytesAtomic(const std::string& fileName, const void* data, size_t size);
 }
\ No newline at end of file
@@ -1,8 +1,77 @@
 #include "Engine.h"
 
+#include <cstring>
+#include <cstdlib>
+
 int main(int argc, char* args[])
 {
-	Engine engine;
+	EngineConfig config;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(args[i], "--headless") == 0)
+		{
+			config.Headless = true;
+		}
+		else if (std::strcmp(args[i], "--parallel") == 0)
+		{
+			config.ParallelRecording = true;
+		}
+		else if (std::strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+		{
+			config.FrameLimit = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--width") == 0 && i + 1 < argc)
+		{
+			config.Width = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--height") == 0 && i + 1 < argc)
+		{
+			config.Height = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--profile") == 0 && i + 1 < argc)
+		{
+			const char* profile = args[++i];
+			if (std::strcmp(profile, "latency") == 0)
+			{
+				config.Profile = PresentProfile::LowLatency;
+			}
+			else if (std::strcmp(profile, "power") == 0)
+			{
+				config.Profile = PresentProfile::PowerSaving;
+			}
+			else
+			{
+				config.Profile = PresentProfile::MaxThroughput;
+			}
+		}
+		else if (std::strcmp(args[i], "--frames-ahead") == 0 && i + 1 < argc)
+		{
+			config.FramesAhead = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--images") == 0 && i + 1 < argc)
+		{
+			config.ImageCount = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--trace") == 0 && i + 1 < argc)
+		{
+			config.TracePath = args[++i];
+		}
+		else if (std::strcmp(args[i], "--instances") == 0 && i + 1 < argc)
+		{
+			config.Instances = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--objects") == 0 && i + 1 < argc)
+		{
+			config.Objects = static_cast<uint32_t>(std::strtoul(args[++i], nullptr, 10));
+		}
+		else if (std::strcmp(args[i], "--bindless") == 0)
+		{
+			config.Bindless = true;
+		}
+	}
+
+	Engine engine(config);
 
 	return 0;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VertexFormat.h"
+
+#include <cstdint>
+
+// On-disk layout of cooked .mesh files, shared by the runtime and the mesh cooker.
+//
+// Header | Vertices | Indices (each Alignment aligned)
+//
+// The cooker has already ordered the indices for the post transform cache and overdraw and the vertices
+// in the order the indices first reference them, so the loader only has to copy both blocks to the GPU.
+// Everything is little endian.
+namespace MeshFormat
+{
+	const uint32_t Magic = 0x48534D44; // "DMSH"
+	const uint32_t Version = 2;
+	const uint64_t Alignment = 16;
+
+	// 20 bytes, positions stay full precision so neighbouring meshes don't crack
+	struct Vertex
+	{
+		float Position[3];
+		int16_t Normal[2]; // Octahedral
+		uint16_t TexCoord[2]; // Half
+	};
+
+	// PipelineDescription::VertexFormats for shaders taking (position, normal, texcoord) at locations 0, 1, 2
+	const AttributeType VertexFormats[] = { AttributeType::Float3, AttributeType::Octahedral16, AttributeType::Half2 };
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VertexCount;
+		uint32_t VertexStride;
+		uint32_t IndexCount;
+		uint32_t IndexSize; // 2 when every vertex fits 16 bit indices, 4 otherwise
+		uint64_t VerticesOffset;
+		uint64_t IndicesOffset;
+
+		// Object space bounds, the sphere is centered on the box
+		float BoundsMin[3];
+		float BoundsMax[3];
+		float Center[3];
+		float Radius;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,420 @@
+#include "SpirvReflection.h"
+
+#include "Common.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+// Subset of spirv.h, we don't ship the SPIR-V headers
+namespace
+{
+	const uint32_t MagicNumber = 0x07230203;
+
+	enum Op : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructure = 5341
+	};
+
+	enum Decoration : uint32_t
+	{
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35
+	};
+
+	enum StorageClass : uint32_t
+	{
+		StorageUniformConstant = 0,
+		StorageInput = 1,
+		StorageUniform = 2,
+		StoragePushConstant = 9,
+		StorageStorageBuffer = 12
+	};
+
+	const uint32_t DimBuffer = 5;
+	const uint32_t Unset = ~0u;
+
+	struct Member
+	{
+		uint32_t Offset = 0;
+		uint32_t MatrixStride = 0;
+	};
+
+	struct Id
+	{
+		uint32_t Opcode = 0;
+		uint32_t Operands[3] = { 0, 0, 0 }; // Meaning depends on the opcode
+		std::vector<uint32_t> MemberTypes;
+
+		// Decorations
+		uint32_t Location = Unset;
+		uint32_t Binding = Unset;
+		uint32_t Set = Unset;
+		uint32_t ArrayStride = 0;
+		bool BuiltIn = false;
+		bool Block = false;
+		bool BufferBlock = false;
+		std::vector<Member> Members;
+	};
+
+	struct Module
+	{
+		std::unordered_map<uint32_t, Id> Ids;
+
+		const Id& Get(uint32_t id) const
+		{
+			static const Id empty;
+			auto it = Ids.find(id);
+			return it != Ids.end() ? it->second : empty;
+		}
+
+		// Strips arrays, returns the element type and the total element count (0 if runtime sized)
+		uint32_t Unwrap(uint32_t typeId, uint32_t& count) const
+		{
+			count = 1;
+			const Id* type = &Get(typeId);
+			while (type->Opcode == OpTypeArray || type->Opcode == OpTypeRuntimeArray)
+			{
+				count = type->Opcode == OpTypeRuntimeArray ? 0 : count * Get(type->Operands[1]).Operands[0];
+				typeId = type->Operands[0];
+				type = &Get(typeId);
+			}
+			return typeId;
+		}
+
+		uint32_t SizeOf(uint32_t typeId, uint32_t matrixStride = 0) const
+		{
+			const Id& type = Get(typeId);
+			switch (type.Opcode)
+			{
+			case OpTypeInt:
+			case OpTypeFloat:
+				return type.Operands[0] / 8;
+			case OpTypeVector:
+				return SizeOf(type.Operands[0]) * type.Operands[1];
+			case OpTypeMatrix:
+				return (matrixStride != 0 ? matrixStride : SizeOf(type.Operands[0])) * type.Operands[1];
+			case OpTypeArray:
+			{
+				uint32_t length = Get(type.Operands[1]).Operands[0];
+				return (type.ArrayStride != 0 ? type.ArrayStride : SizeOf(type.Operands[0])) * length;
+			}
+			case OpTypeStruct:
+			{
+				uint32_t size = 0;
+				for (size_t i = 0; i < type.MemberTypes.size(); i++)
+				{
+					Member member = i < type.Members.size() ? type.Members[i] : Member();
+					size = std::max(size, member.Offset + SizeOf(type.MemberTypes[i], member.MatrixStride));
+				}
+				return size;
+			}
+			default:
+				return 0; // Runtime arrays and opaque types have no static size
+			}
+		}
+
+		VkFormat FormatOf(uint32_t typeId) const
+		{
+			const Id* type = &Get(typeId);
+			uint32_t components = 1;
+			if (type->Opcode == OpTypeVector)
+			{
+				components = type->Operands[1];
+				type = &Get(type->Operands[0]);
+			}
+
+			if (type->Operands[0] != 32 || components < 1 || components > 4)
+				return VK_FORMAT_UNDEFINED;
+
+			static const VkFormat floats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static const VkFormat ints[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static const VkFormat uints[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+			if (type->Opcode == OpTypeFloat)
+				return floats[components - 1];
+			if (type->Opcode == OpTypeInt)
+				return type->Operands[1] ? ints[components - 1] : uints[components - 1];
+
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		VkDescriptorType DescriptorTypeOf(uint32_t storageClass, uint32_t typeId) const
+		{
+			const Id& type = Get(typeId);
+
+			if (storageClass == StorageStorageBuffer)
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+			if (storageClass == StorageUniform)
+				return type.BufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+			switch (type.Opcode)
+			{
+			case OpTypeSampler:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case OpTypeSampledImage:
+				return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case OpTypeImage:
+			{
+				// Operands: sampled type, dim, sampled (1 = sampled, 2 = storage)
+				bool storage = type.Operands[2] == 2;
+				if (type.Operands[1] == DimBuffer)
+					return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			case OpTypeAccelerationStructure:
+				return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			default:
+				return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+			}
+		}
+	};
+
+	VkShaderStageFlagBits StageOf(uint32_t executionModel)
+	{
+		switch (executionModel)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default: return VK_SHADER_STAGE_ALL;
+		}
+	}
+}
+
+bool SpirvReflection::Reflect(const File::ByteView& code, ShaderReflection& reflection)
+{
+	reflection = ShaderReflection();
+
+	if (code.Size < 5 * sizeof(uint32_t) || code.Size % sizeof(uint32_t) != 0)
+		return false;
+
+	const uint32_t* words = reinterpret_cast<const uint32_t*>(code.Data);
+	size_t wordCount = code.Size / sizeof(uint32_t);
+
+	if (words[0] != MagicNumber)
+		return false;
+
+	Module module;
+	std::vector<uint32_t> variables;
+	bool hasEntryPoint = false;
+
+	for (size_t i = 5; i < wordCount;)
+	{
+		uint32_t length = words[i] >> 16;
+		uint32_t opcode = words[i] & 0xFFFF;
+		if (length == 0 || i + length > wordCount)
+			return false;
+
+		const uint32_t* operands = words + i + 1;
+		uint32_t operandCount = length - 1;
+
+		switch (opcode)
+		{
+		case OpEntryPoint:
+			// First entry point wins, we don't do multi entry point modules
+			if (!hasEntryPoint)
+			{
+				reflection.Stage = StageOf(operands[0]);
+				hasEntryPoint = true;
+			}
+			break;
+
+		case OpTypeInt:
+		case OpTypeFloat:
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeImage:
+		case OpTypeSampler:
+		case OpTypeSampledImage:
+		case OpTypeArray:
+		case OpTypeRuntimeArray:
+		case OpTypeAccelerationStructure:
+		case OpConstant:
+		{
+			// Types lead with their result id, constants with their result type
+			Id& id = module.Ids[opcode == OpConstant ? operands[1] : operands[0]];
+			id.Opcode = opcode;
+
+			// Images start with the sampled type, then dim, depth, arrayed, ms, sampled
+			if (opcode == OpTypeImage && operandCount >= 7)
+			{
+				id.Operands[0] = operands[1];
+				id.Operands[1] = operands[2];
+				id.Operands[2] = operands[6];
+			}
+			else if (opcode == OpConstant && operandCount >= 3)
+			{
+				id.Operands[0] = operands[2]; // Low word is enough for array lengths
+			}
+			else
+			{
+				for (uint32_t j = 1; j < operandCount && j <= 3; j++)
+				{
+					id.Operands[j - 1] = operands[j];
+				}
+			}
+			break;
+		}
+
+		case OpTypeStruct:
+		{
+			Id& id = module.Ids[operands[0]];
+			id.Opcode = opcode;
+			id.MemberTypes.assign(operands + 1, operands + operandCount);
+			break;
+		}
+
+		case OpTypePointer:
+		{
+			Id& id = module.Ids[operands[0]];
+			id.Opcode = opcode;
+			id.Operands[0] = operands[1]; // Storage class
+			id.Operands[1] = operands[2]; // Pointee
+			break;
+		}
+
+		case OpVariable:
+		{
+			Id& id = module.Ids[operands[1]];
+			id.Opcode = opcode;
+			id.Operands[0] = operands[2]; // Storage class
+			id.Operands[1] = operands[0]; // Pointer type
+			variables.push_back(operands[1]);
+			break;
+		}
+
+		case OpDecorate:
+		{
+			Id& id = module.Ids[operands[0]];
+			switch (operands[1])
+			{
+			case DecorationBlock: id.Block = true; break;
+			case DecorationBufferBlock: id.BufferBlock = true; break;
+			case DecorationBuiltIn: id.BuiltIn = true; break;
+			case DecorationArrayStride: id.ArrayStride = operands[2]; break;
+			case DecorationLocation: id.Location = operands[2]; break;
+			case DecorationBinding: id.Binding = operands[2]; break;
+			case DecorationDescriptorSet: id.Set = operands[2]; break;
+			}
+			break;
+		}
+
+		case OpMemberDecorate:
+		{
+			Id& id = module.Ids[operands[0]];
+			uint32_t index = operands[1];
+			if (index >= id.Members.size())
+			{
+				id.Members.resize(index + 1);
+			}
+
+			if (operands[2] == DecorationOffset)
+				id.Members[index].Offset = operands[3];
+			else if (operands[2] == DecorationMatrixStride)
+				id.Members[index].MatrixStride = operands[3];
+			else if (operands[2] == DecorationBuiltIn)
+				id.BuiltIn = true; // gl_PerVertex blocks
+			break;
+		}
+		}
+
+		i += length;
+	}
+
+	if (!hasEntryPoint)
+		return false;
+
+	for (uint32_t variableId : variables)
+	{
+		const Id& variable = module.Get(variableId);
+		const Id& pointer = module.Get(variable.Operands[1]);
+		uint32_t storageClass = variable.Operands[0];
+
+		uint32_t count = 1;
+		uint32_t typeId = module.Unwrap(pointer.Operands[1], count);
+
+		switch (storageClass)
+		{
+		case StorageInput:
+		{
+			// Vertex inputs only, everything later in the pipeline is fed by the previous stage
+			if (reflection.Stage != VK_SHADER_STAGE_VERTEX_BIT || variable.BuiltIn || module.Get(typeId).BuiltIn || variable.Location == Unset)
+				break;
+
+			// Matrices take a location per column, arrays a location per element
+			const Id& type = module.Get(typeId);
+			uint32_t columns = 1;
+			if (type.Opcode == OpTypeMatrix)
+			{
+				columns = type.Operands[1];
+				typeId = type.Operands[0];
+			}
+
+			for (uint32_t i = 0; i < count * columns; i++)
+			{
+				ShaderInput input;
+				input.Location = variable.Location + i;
+				input.Format = module.FormatOf(typeId);
+				input.Size = module.SizeOf(typeId);
+				CRITICAL_ASSERT(input.Format != VK_FORMAT_UNDEFINED, "Unsupported vertex input type at location %u", input.Location);
+
+				reflection.Inputs.push_back(input);
+			}
+			break;
+		}
+
+		case StoragePushConstant:
+			reflection.PushConstantSize = std::max(reflection.PushConstantSize, module.SizeOf(typeId));
+			break;
+
+		case StorageUniformConstant:
+		case StorageUniform:
+		case StorageStorageBuffer:
+		{
+			ShaderBinding binding;
+			binding.Set = variable.Set != Unset ? variable.Set : 0;
+			binding.Binding = variable.Binding != Unset ? variable.Binding : 0;
+			binding.Type = module.DescriptorTypeOf(storageClass, typeId);
+			binding.Count = count;
+
+			if (binding.Type != VK_DESCRIPTOR_TYPE_MAX_ENUM)
+			{
+				reflection.Bindings.push_back(binding);
+			}
+			break;
+		}
+		}
+	}
+
+	std::sort(reflection.Inputs.begin(), reflection.Inputs.end(),
+		[](const ShaderInput& a, const ShaderInput& b) { return a.Location < b.Location; });
+
+	return true;
+}
\ No newline at end of file
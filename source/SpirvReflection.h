@@ -0,0 +1,38 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include "File.h"
+
+#include <vector>
+#include <cstdint>
+
+struct ShaderInput
+{
+	uint32_t Location = 0;
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	uint32_t Size = 0; // Bytes, as the shader reads it
+};
+
+struct ShaderBinding
+{
+	uint32_t Set = 0;
+	uint32_t Binding = 0;
+	VkDescriptorType Type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+	uint32_t Count = 1; // 0 for runtime sized arrays
+};
+
+// What a single SPIR-V module expects from the pipeline around it
+struct ShaderReflection
+{
+	VkShaderStageFlagBits Stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::vector<ShaderInput> Inputs; // Sorted by location, built-ins are skipped
+	std::vector<ShaderBinding> Bindings;
+	uint32_t PushConstantSize = 0;
+};
+
+// Minimal SPIR-V parser, only walks the declarations we need for layouts, never the function bodies
+namespace SpirvReflection
+{
+	bool Reflect(const File::ByteView& code, ShaderReflection& reflection);
+}
\ No newline at end of file
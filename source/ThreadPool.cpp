@@ -0,0 +1,148 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+static thread_local const ThreadPool* CurrentPool = nullptr;
+static thread_local uint32_t CurrentWorker = 0;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	Threads.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	JobAvailable.notify_all();
+
+	for (std::thread& thread : Threads)
+	{
+		thread.join();
+	}
+}
+
+uint32_t ThreadPool::GetWorkerIndex() const
+{
+	return CurrentPool == this ? CurrentWorker : GetThreadCount();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Jobs.push_back(std::move(job));
+	}
+	JobAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t worker)>& function)
+{
+	if (count == 0)
+		return;
+
+	struct Work
+	{
+		std::atomic<uint32_t> Next{ 0 };
+		std::atomic<uint32_t> Done{ 0 };
+		std::mutex Mutex;
+		std::condition_variable Finished;
+	};
+
+	// Helpers can still be queued when we return, so they hold on to the shared state themselves
+	std::shared_ptr<Work> work = std::make_shared<Work>();
+
+	auto run = [this, work, count, &function]()
+	{
+		uint32_t worker = GetWorkerIndex();
+		uint32_t index;
+		while ((index = work->Next.fetch_add(1)) < count)
+		{
+			function(index, worker);
+
+			if (work->Done.fetch_add(1) + 1 == count)
+			{
+				std::lock_guard<std::mutex> lock(work->Mutex);
+				work->Finished.notify_all();
+			}
+		}
+	};
+
+	uint32_t helpers = count - 1 < GetThreadCount() ? count - 1 : GetThreadCount();
+	for (uint32_t i = 0; i < helpers; i++)
+	{
+		// Only touches function while indices are left, which the wait below guarantees outlives
+		Submit(run);
+	}
+
+	run();
+
+	std::unique_lock<std::mutex> lock(work->Mutex);
+	work->Finished.wait(lock, [&]() { return work->Done.load() == count; });
+}
+
+void ThreadPool::ParallelRanges(uint32_t count, const std::function<void(uint32_t first, uint32_t count, uint32_t index, uint32_t worker)>& function)
+{
+	uint32_t rangeCount = GetThreadCount() + 1;
+	uint32_t rangeSize = (count + rangeCount - 1) / rangeCount;
+	uint32_t used = rangeSize > 0 ? (count + rangeSize - 1) / rangeSize : 1;
+
+	ParallelFor(used, [count, rangeSize, &function](uint32_t index, uint32_t worker)
+	{
+		uint32_t first = index * rangeSize;
+		uint32_t last = first + rangeSize < count ? first + rangeSize : count;
+		function(first, last - first, index, worker);
+	});
+}
+
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	Idle.wait(lock, [this]() { return Jobs.empty() && ActiveJobs == 0; });
+}
+
+void ThreadPool::WorkerLoop(uint32_t index)
+{
+	CurrentPool = this;
+	CurrentWorker = index;
+
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			JobAvailable.wait(lock, [this]() { return Stopping || !Jobs.empty(); });
+
+			if (Stopping && Jobs.empty())
+				return;
+
+			job = std::move(Jobs.front());
+			Jobs.pop_front();
+			ActiveJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			ActiveJobs--;
+			if (Jobs.empty() && ActiveJobs == 0)
+			{
+				Idle.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+class ThreadPool
+{
+public:
+	// 0 picks one thread per hardware thread minus the calling one
+	ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(Threads.size()); }
+
+	// Worker index of the calling thread, pool threads are [0, GetThreadCount()), anything else gets GetThreadCount()
+	uint32_t GetWorkerIndex() const;
+
+	void Submit(std::function<void()> job);
+
+	// Runs function(index, worker) for every index in [0, count) and blocks until all of them are done.
+	// The calling thread helps out, so this never deadlocks on a pool busy with long jobs.
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t worker)>& function);
+
+	// Splits [0, count) into at most one contiguous range per thread, the caller included, and runs
+	// function(first, count, index, worker) for each. Range indices follow the order of the ranges, so
+	// results can be stitched back together deterministically. Always runs range 0, even when count is 0.
+	void ParallelRanges(uint32_t count, const std::function<void(uint32_t first, uint32_t count, uint32_t index, uint32_t worker)>& function);
+
+	// Blocks until the queue is empty and no job is running
+	void WaitIdle();
+
+private:
+	std::vector<std::thread> Threads;
+	std::deque<std::function<void()>> Jobs;
+
+	std::mutex Mutex;
+	std::condition_variable JobAvailable;
+	std::condition_variable Idle;
+
+	uint32_t ActiveJobs = 0;
+	bool Stopping = false;
+
+	void WorkerLoop(uint32_t index);
+};
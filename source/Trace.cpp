@@ -0,0 +1,75 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+
+static std::mutex TraceMutex;
+static FILE* TraceFile = nullptr;
+static bool FirstEvent = true;
+static int64_t Origin = 0; // Keeps timestamps small, the viewer doesn't care where zero is
+static std::atomic<bool> Tracing{ false }; // Checked by every release build profile scope, so no lock
+
+bool Trace::Open(const char* fileName)
+{
+	std::lock_guard<std::mutex> lock(TraceMutex);
+	if (TraceFile != nullptr)
+		return true;
+
+	TraceFile = std::fopen(fileName, "wb");
+	if (TraceFile == nullptr)
+		return false;
+
+	std::fputs("{\"traceEvents\":[\n", TraceFile);
+	FirstEvent = true;
+	Origin = Now();
+	Tracing.store(true, std::memory_order_release);
+
+	return true;
+}
+
+void Trace::Close()
+{
+	std::lock_guard<std::mutex> lock(TraceMutex);
+	if (TraceFile == nullptr)
+		return;
+
+	std::fputs("\n]}\n", TraceFile);
+	std::fclose(TraceFile);
+	TraceFile = nullptr;
+	Tracing.store(false, std::memory_order_release);
+}
+
+bool Trace::IsOpen()
+{
+	return Tracing.load(std::memory_order_acquire);
+}
+
+int64_t Trace::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::SetThreadName(uint32_t thread, const char* name)
+{
+	std::lock_guard<std::mutex> lock(TraceMutex);
+	if (TraceFile == nullptr)
+		return;
+
+	std::fprintf(TraceFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+		FirstEvent ? "" : ",\n", thread, name);
+	FirstEvent = false;
+}
+
+void Trace::Complete(const char* name, uint32_t thread, int64_t start, int64_t end)
+{
+	std::lock_guard<std::mutex> lock(TraceMutex);
+	if (TraceFile == nullptr)
+		return;
+
+	// Microseconds with sub-microsecond precision, GPU zones are often shorter than that
+	std::fprintf(TraceFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+		FirstEvent ? "" : ",\n", name, thread, (start - Origin) / 1000.0, (end - start) / 1000.0);
+	FirstEvent = false;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// Chrome trace_event JSON output (chrome://tracing, ui.perfetto.dev).
+// Events are streamed to the file as they come in, all calls are thread safe and no-ops while no trace is open.
+namespace Trace
+{
+	// Thread ids used for the timelines, CPU threads use their own index above these
+	enum : uint32_t
+	{
+		GpuThread = 0,
+		MainThread = 1
+	};
+
+	bool Open(const char* fileName);
+	void Close();
+	bool IsOpen();
+
+	// Nanoseconds on the steady clock, the time base for every event
+	int64_t Now();
+
+	void SetThreadName(uint32_t thread, const char* name);
+
+	// Complete ("X") event, name has to be a string literal or otherwise outlive the call
+	void Complete(const char* name, uint32_t thread, int64_t start, int64_t end);
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Packed vertex attribute types and the CPU side encoders that produce them.
+// Kept free of Vulkan so offline tools can encode with the exact same rounding, see GetAttributeFormat
+// in VulkanBuffer.h for the matching VkFormats.
+enum class AttributeType : uint32_t
+{
+	Default, // Whatever the shader declares, as full 32 bit components
+
+	Float,
+	Float2,
+	Float3,
+	Float4,
+
+	Half2,
+	Half4,
+
+	Snorm8x2,
+	Snorm8x4,
+	Unorm8x2,
+	Unorm8x4,
+
+	Snorm16x2,
+	Snorm16x4,
+	Unorm16x2,
+	Unorm16x4,
+
+	// Unit vectors folded onto an octahedron, two snorms the shader decodes with
+	//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	//   n.xy += mix(vec2(max(-n.z, 0.0)), vec2(-max(-n.z, 0.0)), greaterThanEqual(n.xy, vec2(0.0)));
+	//   n = normalize(n);
+	Octahedral8,
+	Octahedral16,
+
+	A2B10G10R10Snorm, // Not every device fetches this one, the pipeline checks
+	A2B10G10R10Unorm,
+
+	UnsignedInt,
+
+	Count
+};
+
+namespace VertexFormat
+{
+	// Bytes per vertex, 0 for Default
+	inline uint32_t GetSize(AttributeType type)
+	{
+		switch (type)
+		{
+		case AttributeType::Float: return 4;
+		case AttributeType::Float2: return 8;
+		case AttributeType::Float3: return 12;
+		case AttributeType::Float4: return 16;
+		case AttributeType::Half2: return 4;
+		case AttributeType::Half4: return 8;
+		case AttributeType::Snorm8x2: return 2;
+		case AttributeType::Snorm8x4: return 4;
+		case AttributeType::Unorm8x2: return 2;
+		case AttributeType::Unorm8x4: return 4;
+		case AttributeType::Snorm16x2: return 4;
+		case AttributeType::Snorm16x4: return 8;
+		case AttributeType::Unorm16x2: return 4;
+		case AttributeType::Unorm16x4: return 8;
+		case AttributeType::Octahedral8: return 2;
+		case AttributeType::Octahedral16: return 4;
+		case AttributeType::A2B10G10R10Snorm: return 4;
+		case AttributeType::A2B10G10R10Unorm: return 4;
+		case AttributeType::UnsignedInt: return 4;
+		default: return 0;
+		}
+	}
+
+	// IEEE binary16, rounds to nearest even, overflows to infinity and keeps NaNs NaN
+	inline uint16_t EncodeHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t exponent = (bits >> 23) & 0xFF;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		if (exponent == 0xFF)
+			return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+		int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+		if (halfExponent >= 31)
+			return static_cast<uint16_t>(sign | 0x7C00);
+
+		if (halfExponent <= 0)
+		{
+			// Subnormal or zero
+			if (halfExponent < -10)
+				return static_cast<uint16_t>(sign);
+
+			mantissa |= 0x800000;
+			uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (half & 1)))
+			{
+				half++;
+			}
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1FFF;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		{
+			half++; // Carries into the exponent and up to infinity correctly
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	// Same conversions Vulkan uses to decode, snorm maps -1 to -max rather than -max - 1
+	inline int8_t EncodeSnorm8(float value)
+	{
+		return static_cast<int8_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 127.0f));
+	}
+
+	inline uint8_t EncodeUnorm8(float value)
+	{
+		return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+	}
+
+	inline int16_t EncodeSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+	}
+
+	inline uint16_t EncodeUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+	}
+
+	// Components in memory order, which is also what Unorm8x4 reads as a little endian uint32
+	inline uint32_t PackUnorm8x4(float x, float y, float z, float w)
+	{
+		return
+			static_cast<uint32_t>(EncodeUnorm8(x)) |
+			static_cast<uint32_t>(EncodeUnorm8(y)) << 8 |
+			static_cast<uint32_t>(EncodeUnorm8(z)) << 16 |
+			static_cast<uint32_t>(EncodeUnorm8(w)) << 24;
+	}
+
+	inline uint32_t PackSnorm8x4(float x, float y, float z, float w)
+	{
+		return
+			static_cast<uint32_t>(static_cast<uint8_t>(EncodeSnorm8(x))) |
+			static_cast<uint32_t>(static_cast<uint8_t>(EncodeSnorm8(y))) << 8 |
+			static_cast<uint32_t>(static_cast<uint8_t>(EncodeSnorm8(z))) << 16 |
+			static_cast<uint32_t>(static_cast<uint8_t>(EncodeSnorm8(w))) << 24;
+	}
+
+	// R in the low bits, alpha in the top two
+	inline uint32_t PackA2B10G10R10Unorm(float x, float y, float z, float w)
+	{
+		auto encode = [](float value, float scale)
+		{
+			return static_cast<uint32_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * scale));
+		};
+		return encode(x, 1023.0f) | encode(y, 1023.0f) << 10 | encode(z, 1023.0f) << 20 | encode(w, 3.0f) << 30;
+	}
+
+	inline uint32_t PackA2B10G10R10Snorm(float x, float y, float z, float w)
+	{
+		auto encode = [](float value, float scale, uint32_t mask)
+		{
+			return static_cast<uint32_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * scale)) & mask;
+		};
+		return encode(x, 511.0f, 0x3FF) | encode(y, 511.0f, 0x3FF) << 10 | encode(z, 511.0f, 0x3FF) << 20 | encode(w, 1.0f, 0x3) << 30;
+	}
+
+	// Normal doesn't have to be normalized, zero length comes out as +Z
+	inline void EncodeOctahedral(const float normal[3], float& u, float& v)
+	{
+		float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+		if (length == 0.0f)
+		{
+			u = 0.0f;
+			v = 0.0f;
+			return;
+		}
+
+		float x = normal[0] / length;
+		float y = normal[1] / length;
+		if (normal[2] < 0.0f)
+		{
+			// Fold the lower hemisphere over the diagonals
+			float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		u = x;
+		v = y;
+	}
+
+	inline void EncodeOctahedral16(const float normal[3], int16_t encoded[2])
+	{
+		float u, v;
+		EncodeOctahedral(normal, u, v);
+		encoded[0] = EncodeSnorm16(u);
+		encoded[1] = EncodeSnorm16(v);
+	}
+
+	inline void EncodeOctahedral8(const float normal[3], int8_t encoded[2])
+	{
+		float u, v;
+		EncodeOctahedral(normal, u, v);
+		encoded[0] = EncodeSnorm8(u);
+		encoded[1] = EncodeSnorm8(v);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "VulkanBindless.h"
+
+#include "VulkanDevice.h"
+#include "Common.h"
+
+#include <algorithm>
+
+VulkanBindless::VulkanBindless()
+{
+}
+
+void VulkanBindless::Create()
+{
+	if (!Device->DescriptorIndexing)
+	{
+		LOG_VK("Bindless: descriptor indexing not available");
+		return;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing = {};
+	indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexing;
+	vkGetPhysicalDeviceProperties2(Device->PhysicalDevice, &properties);
+
+	// Every stage sees the set, so the per stage limits apply as well. Images and buffers share the resource limit,
+	// and each limit keeps RESERVED_DESCRIPTORS for sets 0 to SET - 1.
+	auto available = [this](uint32_t limit)
+	{
+		return limit > RESERVED_DESCRIPTORS ? limit - RESERVED_DESCRIPTORS : 0;
+	};
+
+	uint32_t resources = available(indexing.maxPerStageUpdateAfterBindResources) / 2;
+	Capacity[static_cast<uint32_t>(BindlessType::Image)] = std::min({ MAX_IMAGES, resources,
+		available(indexing.maxDescriptorSetUpdateAfterBindSampledImages), available(indexing.maxPerStageDescriptorUpdateAfterBindSampledImages) });
+	Capacity[static_cast<uint32_t>(BindlessType::Buffer)] = std::min({ MAX_BUFFERS, resources,
+		available(indexing.maxDescriptorSetUpdateAfterBindStorageBuffers), available(indexing.maxPerStageDescriptorUpdateAfterBindStorageBuffers) });
+	Capacity[static_cast<uint32_t>(BindlessType::Sampler)] = std::min({ MAX_SAMPLERS,
+		available(indexing.maxDescriptorSetUpdateAfterBindSamplers), available(indexing.maxPerStageDescriptorUpdateAfterBindSamplers) });
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(BindlessType::Count); i++)
+	{
+		if (Capacity[i] == 0)
+		{
+			LOG_VK("Bindless: update after bind limits too low");
+			return;
+		}
+	}
+
+	const VkDescriptorType types[] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER };
+	const uint32_t typeCount = static_cast<uint32_t>(BindlessType::Count);
+
+	VkDescriptorSetLayoutBinding bindings[typeCount] = {};
+	VkDescriptorBindingFlagsEXT bindingFlags[typeCount] = {};
+	VkDescriptorPoolSize poolSizes[typeCount] = {};
+
+	for (uint32_t i = 0; i < typeCount; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = types[i];
+		bindings[i].descriptorCount = Capacity[i];
+		bindings[i].stageFlags = VulkanLayoutCache::Stages;
+
+		// Unwritten slots are fine as long as nothing reads them, and free slots can be rewritten while frames are in flight
+		bindingFlags[i] =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+		poolSizes[i].type = types[i];
+		poolSizes[i].descriptorCount = Capacity[i];
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	flagsInfo.bindingCount = typeCount;
+	flagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = typeCount;
+	layoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(Device->Device, &layoutInfo, nullptr, &Layout);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create bindless set layout");
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = typeCount;
+	poolInfo.pPoolSizes = poolSizes;
+
+	result = vkCreateDescriptorPool(Device->Device, &poolInfo, nullptr, &DescriptorPool);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create bindless descriptor pool");
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = DescriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &Layout;
+
+	result = vkAllocateDescriptorSets(Device->Device, &allocateInfo, &DescriptorSet);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate the bindless descriptor set");
+
+	LOG_VK("Bindless: %u images, %u buffers, %u samplers", Capacity[0], Capacity[1], Capacity[2]);
+}
+
+void VulkanBindless::Destroy()
+{
+	// Frees the set with it
+	vkDestroyDescriptorPool(Device->Device, DescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(Device->Device, Layout, nullptr);
+
+	DescriptorPool = VK_NULL_HANDLE;
+	DescriptorSet = VK_NULL_HANDLE;
+	Layout = VK_NULL_HANDLE;
+}
+
+uint32_t VulkanBindless::AddImage(VkImageView view, VkImageLayout layout)
+{
+	VkDescriptorImageInfo info = {};
+	info.imageView = view;
+	info.imageLayout = layout;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	uint32_t handle = Allocate(BindlessType::Image);
+	Write(BindlessType::Image, handle, &info, nullptr);
+	return handle;
+}
+
+uint32_t VulkanBindless::AddBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	VkDescriptorBufferInfo info = {};
+	info.buffer = buffer;
+	info.offset = offset;
+	info.range = range;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	uint32_t handle = Allocate(BindlessType::Buffer);
+	Write(BindlessType::Buffer, handle, nullptr, &info);
+	return handle;
+}
+
+uint32_t VulkanBindless::AddSampler(VkSampler sampler)
+{
+	VkDescriptorImageInfo info = {};
+	info.sampler = sampler;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	uint32_t handle = Allocate(BindlessType::Sampler);
+	Write(BindlessType::Sampler, handle, &info, nullptr);
+	return handle;
+}
+
+void VulkanBindless::Remove(BindlessType type, uint32_t handle)
+{
+	if (handle == INVALID_HANDLE)
+		return;
+
+	PendingRemove pending;
+	pending.Type = type;
+	pending.Handle = handle;
+	pending.Frame = Device->FrameCount;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	PendingRemoves.push_back(pending);
+}
+
+void VulkanBindless::BeginFrame()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	// Stale descriptors stay in the slot, partially bound only cares that nothing reads them
+	while (!PendingRemoves.empty() && Device->IsFrameRetired(PendingRemoves.front().Frame))
+	{
+		const PendingRemove& pending = PendingRemoves.front();
+		Allocated[static_cast<uint32_t>(pending.Type)].Free.push_back(pending.Handle);
+		PendingRemoves.pop_front();
+	}
+}
+
+void VulkanBindless::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout)
+{
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, SET, 1, &DescriptorSet, 0, nullptr);
+}
+
+uint32_t VulkanBindless::Allocate(BindlessType type)
+{
+	CRITICAL_ASSERT(IsAvailable(), "Bindless resources need descriptor indexing");
+
+	uint32_t index = static_cast<uint32_t>(type);
+
+	Slots& slots = Allocated[index];
+	if (!slots.Free.empty())
+	{
+		uint32_t handle = slots.Free.back();
+		slots.Free.pop_back();
+		return handle;
+	}
+
+	CRITICAL_ASSERT(slots.Next < Capacity[index], "Bindless set is full (%u of type %u)", Capacity[index], index);
+	return slots.Next++;
+}
+
+void VulkanBindless::Write(BindlessType type, uint32_t handle, const VkDescriptorImageInfo* image, const VkDescriptorBufferInfo* buffer)
+{
+	const VkDescriptorType types[] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER };
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = DescriptorSet;
+	write.dstBinding = static_cast<uint32_t>(type);
+	write.dstArrayElement = handle;
+	write.descriptorCount = 1;
+	write.descriptorType = types[static_cast<uint32_t>(type)];
+	write.pImageInfo = image;
+	write.pBufferInfo = buffer;
+
+	vkUpdateDescriptorSets(Device->Device, 1, &write, 0, nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+// Binding of each array in the global set, also what a handle indexes into
+enum class BindlessType : uint32_t
+{
+	Image, // texture2D images[]
+	Buffer, // buffer { ... } buffers[]
+	Sampler, // sampler samplers[]
+	Count
+};
+
+// One global descriptor set (VK_EXT_descriptor_indexing) holding every sampled image, storage buffer and sampler.
+// Resources are written once and addressed by plain uint32_t handles, usually passed in push constants, so draws
+// never bind descriptors per material. Shaders declare the runtime sized arrays in set SET at the bindings above;
+// the layout cache swaps in Layout for that set, so every pipeline using it stays compatible and the set is bound
+// once per layout. Slots are only handed out again once no frame in flight can read them.
+class VulkanBindless
+{
+public:
+	VulkanBindless();
+
+	class VulkanDevice* Device;
+
+	static const uint32_t SET = 3; // maxBoundDescriptorSets is at least 4
+	static const uint32_t INVALID_HANDLE = ~0u;
+
+	// Null if the device lacks descriptor indexing
+	VkDescriptorSetLayout Layout = VK_NULL_HANDLE;
+	VkDescriptorPool DescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+
+	uint32_t Capacity[static_cast<uint32_t>(BindlessType::Count)] = {};
+
+	void Create();
+	void Destroy();
+
+	bool IsAvailable() const { return Layout != VK_NULL_HANDLE; }
+
+	// Thread safe, update after bind lets these run while the set is bound in command buffers being recorded or in flight
+	uint32_t AddImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	uint32_t AddBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	uint32_t AddSampler(VkSampler sampler);
+
+	// Main thread, the resource has to outlive every frame recorded so far
+	void Remove(BindlessType type, uint32_t handle);
+
+	// After the frame's fence was waited on
+	void BeginFrame();
+
+	// Binds the set for pipelines whose layout has it at SET
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+protected:
+	// Upper bounds, clamped to the device's update after bind limits
+	const uint32_t MAX_IMAGES = 16384;
+	const uint32_t MAX_BUFFERS = 16384;
+	const uint32_t MAX_SAMPLERS = 64;
+
+	// Left out of every limit for the other sets of a layout (frame allocator, per pass sets), the update after
+	// bind limits count every descriptor in the pipeline layout, not just this set's
+	const uint32_t RESERVED_DESCRIPTORS = 64;
+
+	struct Slots
+	{
+		std::vector<uint32_t> Free;
+		uint32_t Next = 0; // Never used above this
+	};
+
+	struct PendingRemove
+	{
+		BindlessType Type;
+		uint32_t Handle;
+		uint64_t Frame;
+	};
+
+	Slots Allocated[static_cast<uint32_t>(BindlessType::Count)];
+	std::deque<PendingRemove> PendingRemoves;
+
+	std::mutex Mutex;
+
+	// Require Mutex, the set's host access has to be synchronized
+	uint32_t Allocate(BindlessType type);
+	void Write(BindlessType type, uint32_t handle, const VkDescriptorImageInfo* image, const VkDescriptorBufferInfo* buffer);
+};
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "Common.h"
 #include "VulkanDevice.h"
 
+#include <cstring>
+#include <vector>
+
 VulkanBuffer::VulkanBuffer()
 {
 }
@@ -14,6 +17,12 @@ VulkanBuffer* VulkanBuffer::Create(VulkanDevice* device, BufferType type, const
 	return buffer;
 }
 
+void VulkanBuffer::Destroy(VulkanDevice* device, VulkanBuffer* buffer)
+{
+	vmaDestroyBuffer(device->Allocator, buffer->Buffer, buffer->Allocation);
+	delete buffer;
+}
+
 void VulkanBuffer::Init(VulkanDevice* device, BufferType type, const void* data, size_t size)
 {
 	VkBufferUsageFlags flags;
@@ -25,26 +34,120 @@ void VulkanBuffer::Init(VulkanDevice* device, BufferType type, const void* data,
 	case BufferType::Index:
 		flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 		break;
+	case BufferType::Storage:
+		flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		break;
+	case BufferType::Indirect:
+		flags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		break;
 	default:
 		CRITICAL_ERROR("Invalid buffer type");
 	}
 
+	Type = type;
+	Size = size;
+
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
-	bufferInfo.usage = flags;
+	bufferInfo.usage = flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 	VmaAllocationCreateInfo allocationInfo = {};
 	allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	allocationInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 
-	vmaCreateBuffer(device->Allocator, &bufferInfo, &allocationInfo, &Buffer, &Allocation, nullptr);
+	VkResult result = vmaCreateBuffer(device->Allocator, &bufferInfo, &allocationInfo, &Buffer, &Allocation, nullptr);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Buffer creation failed");
+
+	// Device local memory isn't mappable on discrete GPUs, goes through staging instead
+	if (data != nullptr)
+	{
+		device->Uploader.Upload(this, data, size);
+	}
+}
+
+VkIndexType VulkanBuffer::SelectIndexType(const VulkanDevice* device, uint32_t vertexCount)
+{
+	if (vertexCount <= 0x100 && device->IndexTypeUint8)
+		return VK_INDEX_TYPE_UINT8_EXT;
+	if (vertexCount <= 0x10000)
+		return VK_INDEX_TYPE_UINT16;
+	return VK_INDEX_TYPE_UINT32;
+}
+
+uint32_t VulkanBuffer::GetIndexSize(VkIndexType type)
+{
+	switch (type)
+	{
+	case VK_INDEX_TYPE_UINT8_EXT: return 1;
+	case VK_INDEX_TYPE_UINT16: return 2;
+	case VK_INDEX_TYPE_UINT32: return 4;
+	default: CRITICAL_ERROR("Invalid index type %d", static_cast<int>(type));
+	}
+}
 
-	void* destination;
-	vmaMapMemory(device->Allocator, Allocation, &destination);
-	memcpy(destination, data, (size_t)bufferInfo.size);
-	vmaUnmapMemory(device->Allocator, Allocation);
+template <typename Destination, typename Source>
+static void ConvertIndices(Destination* converted, const Source* indices, size_t count, uint32_t vertexCount)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		CRITICAL_ASSERT(indices[i] < vertexCount, "Index %u out of range for %u vertices", static_cast<uint32_t>(indices[i]), vertexCount);
+		converted[i] = static_cast<Destination>(indices[i]);
+	}
+}
+
+template <typename Source>
+static std::vector<uint8_t> PackIndicesFrom(const Source* indices, size_t count, uint32_t vertexCount, VkIndexType type)
+{
+	// Converting checks the range as a side effect, even when the type doesn't change
+	std::vector<uint8_t> packed(count * VulkanBuffer::GetIndexSize(type));
+	switch (type)
+	{
+	case VK_INDEX_TYPE_UINT8_EXT:
+		ConvertIndices(packed.data(), indices, count, vertexCount);
+		break;
+	case VK_INDEX_TYPE_UINT16:
+		ConvertIndices(reinterpret_cast<uint16_t*>(packed.data()), indices, count, vertexCount);
+		break;
+	default:
+		ConvertIndices(reinterpret_cast<uint32_t*>(packed.data()), indices, count, vertexCount);
+		break;
+	}
+	return packed;
+}
+
+std::vector<uint8_t> VulkanBuffer::PackIndices(const uint32_t* indices, size_t count, uint32_t vertexCount, VkIndexType type)
+{
+	return PackIndicesFrom(indices, count, vertexCount, type);
+}
+
+std::vector<uint8_t> VulkanBuffer::PackIndices(const uint16_t* indices, size_t count, uint32_t vertexCount, VkIndexType type)
+{
+	return PackIndicesFrom(indices, count, vertexCount, type);
+}
+
+VulkanBuffer* VulkanBuffer::CreateIndex(VulkanDevice* device, const uint32_t* indices, size_t count, uint32_t vertexCount)
+{
+	VulkanBuffer* buffer = new VulkanBuffer();
+	buffer->IndexType = SelectIndexType(device, vertexCount);
+	buffer->IndexCount = static_cast<uint32_t>(count);
+
+	std::vector<uint8_t> packed = PackIndices(indices, count, vertexCount, buffer->IndexType);
+	buffer->Init(device, BufferType::Index, packed.data(), packed.size());
+
+	return buffer;
+}
+
+VulkanBuffer* VulkanBuffer::CreateIndex(VulkanDevice* device, const uint16_t* indices, size_t count, uint32_t vertexCount)
+{
+	VulkanBuffer* buffer = new VulkanBuffer();
+	buffer->IndexType = SelectIndexType(device, vertexCount);
+	buffer->IndexCount = static_cast<uint32_t>(count);
+
+	std::vector<uint8_t> packed = PackIndices(indices, count, vertexCount, buffer->IndexType);
+	buffer->Init(device, BufferType::Index, packed.data(), packed.size());
+
+	return buffer;
 }
 
 VulkanVertexBuffer::VulkanVertexBuffer()
@@ -58,4 +161,31 @@ VulkanVertexBuffer* VulkanVertexBuffer::Create(VulkanDevice* device, const void*
 	buffer->Attributes = attributes;
 
 	return buffer;
+}
+
+VkFormat GetAttributeFormat(AttributeType type)
+{
+	switch (type)
+	{
+	case AttributeType::Float: return VK_FORMAT_R32_SFLOAT;
+	case AttributeType::Float2: return VK_FORMAT_R32G32_SFLOAT;
+	case AttributeType::Float3: return VK_FORMAT_R32G32B32_SFLOAT;
+	case AttributeType::Float4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case AttributeType::Half2: return VK_FORMAT_R16G16_SFLOAT;
+	case AttributeType::Half4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case AttributeType::Snorm8x2: return VK_FORMAT_R8G8_SNORM;
+	case AttributeType::Snorm8x4: return VK_FORMAT_R8G8B8A8_SNORM;
+	case AttributeType::Unorm8x2: return VK_FORMAT_R8G8_UNORM;
+	case AttributeType::Unorm8x4: return VK_FORMAT_R8G8B8A8_UNORM;
+	case AttributeType::Snorm16x2: return VK_FORMAT_R16G16_SNORM;
+	case AttributeType::Snorm16x4: return VK_FORMAT_R16G16B16A16_SNORM;
+	case AttributeType::Unorm16x2: return VK_FORMAT_R16G16_UNORM;
+	case AttributeType::Unorm16x4: return VK_FORMAT_R16G16B16A16_UNORM;
+	case AttributeType::Octahedral8: return VK_FORMAT_R8G8_SNORM;
+	case AttributeType::Octahedral16: return VK_FORMAT_R16G16_SNORM;
+	case AttributeType::A2B10G10R10Snorm: return VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+	case AttributeType::A2B10G10R10Unorm: return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+	case AttributeType::UnsignedInt: return VK_FORMAT_R32_UINT;
+	default: return VK_FORMAT_UNDEFINED;
+	}
 }
\ No newline at end of file
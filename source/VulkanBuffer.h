@@ -3,12 +3,16 @@
 #include "vulkan/vulkan.h"
 #include "vk_mem_alloc.h"
 
+#include "VertexFormat.h"
+
 #include <vector>
 
 enum class BufferType
 {
 	Vertex,
-	Index
+	Index,
+	Storage, // Read and written by shaders, can be fetched as vertices too
+	Indirect // Written by compute, read by indirect draws
 };
 
 class VulkanBuffer
@@ -17,7 +21,27 @@ public:
 	VkBuffer Buffer = VK_NULL_HANDLE;
 	VmaAllocation Allocation = nullptr;
 
+	BufferType Type = BufferType::Vertex;
+	VkDeviceSize Size = 0;
+
+	// Index buffers only
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT16;
+	uint32_t IndexCount = 0;
+
 	static VulkanBuffer* Create(class VulkanDevice* device, BufferType type, const void* data, size_t size);
+	static void Destroy(class VulkanDevice* device, VulkanBuffer* buffer);
+
+	// Stores the indices as the smallest type that addresses vertexCount vertices (8 bit where the device
+	// supports it), converting on the way to the uploader. Every index has to be below vertexCount.
+	static VulkanBuffer* CreateIndex(class VulkanDevice* device, const uint32_t* indices, size_t count, uint32_t vertexCount);
+	static VulkanBuffer* CreateIndex(class VulkanDevice* device, const uint16_t* indices, size_t count, uint32_t vertexCount);
+
+	static VkIndexType SelectIndexType(const class VulkanDevice* device, uint32_t vertexCount);
+	static uint32_t GetIndexSize(VkIndexType type);
+
+	// Indices converted to type, asserts every index is below vertexCount
+	static std::vector<uint8_t> PackIndices(const uint32_t* indices, size_t count, uint32_t vertexCount, VkIndexType type);
+	static std::vector<uint8_t> PackIndices(const uint16_t* indices, size_t count, uint32_t vertexCount, VkIndexType type);
 
 protected:
 	void Init(VulkanDevice* device, BufferType type, const void* data, size_t size);
@@ -25,12 +49,8 @@ protected:
 	VulkanBuffer();
 };
 
-enum class AttributeType : uint32_t
-{
-	Float2,
-	Float3,
-	UnsignedInt
-};
+// VK_FORMAT_UNDEFINED for AttributeType::Default
+VkFormat GetAttributeFormat(AttributeType type);
 
 struct VertexAttribute
 {
@@ -0,0 +1,56 @@
+#include "VulkanComputePipeline.h"
+
+#include "Common.h"
+#include "VulkanDevice.h"
+#include "VulkanPipeline.h"
+
+VulkanComputePipeline* VulkanComputePipeline::Create(VulkanDevice* device, const File::ByteView& code, uint32_t dynamicSets)
+{
+	VulkanComputePipeline* pipeline = new VulkanComputePipeline();
+
+	bool valid = SpirvReflection::Reflect(code, pipeline->Reflection);
+	CRITICAL_ASSERT(valid && pipeline->Reflection.Stage == VK_SHADER_STAGE_COMPUTE_BIT, "Invalid compute shader SPIR-V");
+
+	std::vector<const ShaderReflection*> reflections = { &pipeline->Reflection };
+	pipeline->PipelineLayout = device->Layouts.GetPipelineLayout(reflections, dynamicSets, pipeline->SetLayouts);
+	pipeline->UsesBindless = pipeline->SetLayouts.size() > VulkanBindless::SET && pipeline->SetLayouts[VulkanBindless::SET] == device->Bindless.Layout;
+
+	VkShaderModule module = VulkanPipeline::CreateShader(device->Device, code);
+
+	VkComputePipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	createInfo.stage.module = module;
+	createInfo.stage.pName = "main";
+	createInfo.layout = pipeline->PipelineLayout;
+
+	VkResult result = vkCreateComputePipelines(device->Device, device->PipelineCache, 1, &createInfo, nullptr, &pipeline->Pipeline);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Compute pipeline creation failed");
+
+	vkDestroyShaderModule(device->Device, module, nullptr);
+
+	return pipeline;
+}
+
+void VulkanComputePipeline::Destroy(VulkanDevice* device, VulkanComputePipeline* pipeline)
+{
+	vkDestroyPipeline(device->Device, pipeline->Pipeline, nullptr);
+	delete pipeline;
+}
+
+void VulkanComputePipeline::Bind(VulkanDevice* device) const
+{
+	VkCommandBuffer commandBuffer = device->GetCommandBuffer();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline);
+
+	if (UsesBindless)
+	{
+		device->Bindless.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, PipelineLayout);
+	}
+}
+
+void VulkanComputePipeline::Dispatch(VulkanDevice* device, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) const
+{
+	vkCmdDispatch(device->GetCommandBuffer(), groupsX, groupsY, groupsZ);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include "File.h"
+#include "SpirvReflection.h"
+
+#include <vector>
+#include <cstdint>
+
+class VulkanComputePipeline
+{
+public:
+	VkPipeline Pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout PipelineLayout = VK_NULL_HANDLE; // Shared through the device's layout cache, not owned
+
+	std::vector<VkDescriptorSetLayout> SetLayouts;
+	bool UsesBindless = false; // Bind takes care of the set
+
+	ShaderReflection Reflection;
+
+	// Compiled right away, compute pipelines are cheap enough to not need the async cache.
+	// The code is only read during the call, buffers in dynamicSets (bit per set) are bound with dynamic offsets.
+	static VulkanComputePipeline* Create(class VulkanDevice* device, const File::ByteView& code, uint32_t dynamicSets = 0);
+	static void Destroy(class VulkanDevice* device, VulkanComputePipeline* pipeline);
+
+	// Records into the device's current command buffer, outside a render pass. Binds the bindless set if the shader uses it.
+	void Bind(class VulkanDevice* device) const;
+	void Dispatch(class VulkanDevice* device, uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1) const;
+
+protected:
+	VulkanComputePipeline() {}
+};
\ No newline at end of file
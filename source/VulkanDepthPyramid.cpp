@@ -0,0 +1,277 @@
+#include "VulkanDepthPyramid.h"
+
+#include "Common.h"
+#include "VulkanDevice.h"
+#include "VulkanComputePipeline.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+
+VulkanDepthPyramid* VulkanDepthPyramid::Create(VulkanDevice* device, const File::ByteView& reduceShader)
+{
+	CRITICAL_ASSERT(device->Swapchain.UseDepth, "The depth pyramid needs the swapchain's depth, set UseDepth before initializing");
+
+	VulkanDepthPyramid* pyramid = new VulkanDepthPyramid();
+	pyramid->Device = device;
+
+	pyramid->ReducePipeline = VulkanComputePipeline::Create(device, reduceShader);
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	VkResult result = vkCreateSampler(device->Device, &samplerInfo, nullptr, &pyramid->Sampler);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create depth pyramid sampler");
+
+	pyramid->CreateImages();
+
+	return pyramid;
+}
+
+void VulkanDepthPyramid::Destroy(VulkanDevice* device, VulkanDepthPyramid* pyramid)
+{
+	// Retired views were released when they were retired
+	device->Descriptors.ReleasePersistent(pyramid->Current.View);
+
+	for (Images& images : pyramid->Retired)
+	{
+		pyramid->DestroyImages(images);
+	}
+	pyramid->DestroyImages(pyramid->Current);
+
+	vkDestroySampler(device->Device, pyramid->Sampler, nullptr);
+	VulkanComputePipeline::Destroy(device, pyramid->ReducePipeline);
+
+	delete pyramid;
+}
+
+void VulkanDepthPyramid::Build()
+{
+	PROFILE_SCOPE("DepthPyramid::Build");
+
+	size_t retired = 0;
+	for (; retired < Retired.size() && Device->IsFrameRetired(Retired[retired].Frame); retired++)
+	{
+		DestroyImages(Retired[retired]);
+	}
+	Retired.erase(Retired.begin(), Retired.begin() + retired);
+
+	if (Generation != Device->Swapchain.Generation)
+	{
+		// Persistent sets can hold the old view, its handle value may come back once it is destroyed
+		Device->Descriptors.ReleasePersistent(Current.View);
+
+		Current.Frame = Device->FrameCount;
+		Retired.push_back(Current);
+		Current = Images();
+
+		CreateImages();
+	}
+
+	VkCommandBuffer commandBuffer = Device->GetCommandBuffer();
+
+	if (!Initialized)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = Image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = Levels;
+		barrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		Initialized = true;
+	}
+
+	// Depth only exists once a main pass rendered into this swapchain's depth buffer
+	Valid = Device->FrameCount > CreatedFrame;
+	if (!Valid)
+		return;
+
+	Device->Profiler.BeginZone(commandBuffer, "Depth Pyramid");
+
+	// Last frame's culling is done reading before the levels are overwritten, the render pass
+	// dependency already made the depth writes visible
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	ReducePipeline->Bind(Device);
+
+	uint32_t sourceWidth = Width;
+	uint32_t sourceHeight = Height;
+
+	for (uint32_t level = 0; level < Levels; level++)
+	{
+		uint32_t width = std::max(Width >> level, 1u);
+		uint32_t height = std::max(Height >> level, 1u);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ReducePipeline->PipelineLayout, 0, 1, &Current.Sets[level], 0, nullptr);
+
+		ReduceParams params = {};
+		params.SourceSize[0] = static_cast<int32_t>(sourceWidth);
+		params.SourceSize[1] = static_cast<int32_t>(sourceHeight);
+		params.DestinationSize[0] = static_cast<int32_t>(width);
+		params.DestinationSize[1] = static_cast<int32_t>(height);
+		params.Copy = level == 0 ? 1 : 0;
+		vkCmdPushConstants(commandBuffer, ReducePipeline->PipelineLayout, VulkanLayoutCache::Stages, 0, sizeof(params), &params);
+
+		ReducePipeline->Dispatch(Device, (width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE);
+
+		// Next level (or culling) reads what was just written
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+
+	Device->Profiler.EndZone(commandBuffer);
+}
+
+void VulkanDepthPyramid::CreateImages()
+{
+	const VulkanSwapchain& swapchain = Device->Swapchain;
+
+	Generation = swapchain.Generation;
+	CreatedFrame = Device->FrameCount;
+	Initialized = false;
+
+	Width = swapchain.Extent.width;
+	Height = swapchain.Extent.height;
+
+	Levels = 1;
+	while ((std::max(Width, Height) >> Levels) > 0)
+	{
+		Levels++;
+	}
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.extent = { Width, Height, 1 };
+	imageInfo.mipLevels = Levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocationInfo = {};
+	allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VkResult result = vmaCreateImage(Device->Allocator, &imageInfo, &allocationInfo, &Current.Image, &Current.Allocation, nullptr);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Depth pyramid creation failed");
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = Current.Image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = Levels;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(Device->Device, &viewInfo, nullptr, &Current.View);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Depth pyramid view creation failed");
+
+	Current.LevelViews.resize(Levels);
+	for (uint32_t level = 0; level < Levels; level++)
+	{
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+
+		result = vkCreateImageView(Device->Device, &viewInfo, nullptr, &Current.LevelViews[level]);
+		CRITICAL_ASSERT(result == VK_SUCCESS, "Depth pyramid view creation failed");
+	}
+
+	// One set per level, sizes are fixed so a private pool is simplest
+	VkDescriptorPoolSize poolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, Levels },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, Levels }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = Levels;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	result = vkCreateDescriptorPool(Device->Device, &poolInfo, nullptr, &Current.DescriptorPool);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create descriptor pool");
+
+	std::vector<VkDescriptorSetLayout> layouts(Levels, ReducePipeline->SetLayouts[0]);
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = Current.DescriptorPool;
+	allocateInfo.descriptorSetCount = Levels;
+	allocateInfo.pSetLayouts = layouts.data();
+
+	Current.Sets.resize(Levels);
+	result = vkAllocateDescriptorSets(Device->Device, &allocateInfo, Current.Sets.data());
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate descriptor sets");
+
+	std::vector<VkDescriptorImageInfo> imageInfos(Levels * 2);
+	std::vector<VkWriteDescriptorSet> writes(Levels * 2);
+	for (uint32_t level = 0; level < Levels; level++)
+	{
+		VkDescriptorImageInfo& source = imageInfos[level * 2];
+		source.sampler = Sampler;
+		source.imageView = level == 0 ? swapchain.DepthView : Current.LevelViews[level - 1];
+		source.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo& destination = imageInfos[level * 2 + 1];
+		destination.imageView = Current.LevelViews[level];
+		destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		for (uint32_t binding = 0; binding < 2; binding++)
+		{
+			VkWriteDescriptorSet& write = writes[level * 2 + binding];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = Current.Sets[level];
+			write.dstBinding = binding;
+			write.descriptorCount = 1;
+			write.descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			write.pImageInfo = &imageInfos[level * 2 + binding];
+		}
+	}
+
+	vkUpdateDescriptorSets(Device->Device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	Image = Current.Image;
+	Allocation = Current.Allocation;
+	View = Current.View;
+
+	LOG_VK("Depth pyramid: %ux%u, %u levels", Width, Height, Levels);
+}
+
+void VulkanDepthPyramid::DestroyImages(Images& images)
+{
+	vkDestroyDescriptorPool(Device->Device, images.DescriptorPool, nullptr);
+
+	for (VkImageView view : images.LevelViews)
+	{
+		vkDestroyImageView(Device->Device, view, nullptr);
+	}
+	vkDestroyImageView(Device->Device, images.View, nullptr);
+	vmaDestroyImage(Device->Allocator, images.Image, images.Allocation);
+
+	images = Images();
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+
+#include "File.h"
+
+#include <vector>
+#include <cstdint>
+
+class VulkanComputePipeline;
+
+// Farthest depth mip chain of the previous frame's main pass, for occlusion tests.
+// Level 0 matches the depth buffer, every texel above covers the 2x2 below it and the last row/column
+// of an odd sized level folds into the last texel, so min(pixel >> level, size - 1) is a conservative
+// lookup at any level. Kept in VK_IMAGE_LAYOUT_GENERAL.
+class VulkanDepthPyramid
+{
+public:
+	class VulkanDevice* Device;
+
+	VkImage Image = VK_NULL_HANDLE;
+	VmaAllocation Allocation = nullptr;
+	VkImageView View = VK_NULL_HANDLE; // Every level, for culling
+	VkSampler Sampler = VK_NULL_HANDLE; // Nearest, shaders texelFetch anyway
+
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t Levels = 0;
+
+	// Holds the last frame's depth, occlusion tests have to be skipped otherwise
+	bool Valid = false;
+
+	static VulkanDepthPyramid* Create(class VulkanDevice* device, const File::ByteView& reduceShader);
+	static void Destroy(class VulkanDevice* device, VulkanDepthPyramid* pyramid);
+
+	// Between BeginFrame and BeginMainPass, reduces the depth the previous frame left behind.
+	// Follows swapchain resizes, the view changes then.
+	void Build();
+
+protected:
+	const uint32_t GROUP_SIZE = 8; // local_size_x/y of the reduce shader
+
+	struct ReduceParams
+	{
+		int32_t SourceSize[2];
+		int32_t DestinationSize[2];
+		uint32_t Copy;
+	};
+
+	// Everything that depends on the depth buffer's size
+	struct Images
+	{
+		VkImage Image = VK_NULL_HANDLE;
+		VmaAllocation Allocation = nullptr;
+		VkImageView View = VK_NULL_HANDLE;
+		std::vector<VkImageView> LevelViews;
+		VkDescriptorPool DescriptorPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> Sets; // Per level, previous level (or depth) in, this level out
+		uint64_t Frame = 0; // Retired at, destroyed once every frame that could use it is done
+	};
+
+	VulkanComputePipeline* ReducePipeline = nullptr;
+
+	Images Current;
+	std::vector<Images> Retired;
+
+	uint32_t Generation = 0; // Swapchain depth the images were made for
+	uint64_t CreatedFrame = 0;
+	bool Initialized = false; // Transitioned out of UNDEFINED
+
+	VulkanDepthPyramid() {}
+
+	void CreateImages();
+	void DestroyImages(Images& images);
+};
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include "VulkanDescriptorAllocator.h"
+
+#include "VulkanDevice.h"
+#include "Common.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+
+DescriptorBinding DescriptorBinding::MakeBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	DescriptorBinding result;
+	result.Binding = binding;
+	result.Type = type;
+	result.Buffer = buffer;
+	result.Offset = offset;
+	result.Range = range;
+	return result;
+}
+
+DescriptorBinding DescriptorBinding::MakeImage(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+	DescriptorBinding result;
+	result.Binding = binding;
+	result.Type = type;
+	result.View = view;
+	result.Sampler = sampler;
+	result.Layout = layout;
+	return result;
+}
+
+bool VulkanDescriptorAllocator::Key::operator==(const Key& other) const
+{
+	if (Layout != other.Layout || Count != other.Count)
+		return false;
+
+	for (uint32_t i = 0; i < Count; i++)
+	{
+		const DescriptorBinding& a = Bindings[i];
+		const DescriptorBinding& b = other.Bindings[i];
+		if (a.Binding != b.Binding || a.Type != b.Type ||
+			a.Buffer != b.Buffer || a.Offset != b.Offset || a.Range != b.Range ||
+			a.View != b.View || a.Sampler != b.Sampler || a.Layout != b.Layout)
+			return false;
+	}
+	return true;
+}
+
+bool VulkanDescriptorAllocator::Key::Uses(uint64_t handle) const
+{
+	for (uint32_t i = 0; i < Count; i++)
+	{
+		const DescriptorBinding& binding = Bindings[i];
+		if (reinterpret_cast<uint64_t>(binding.Buffer) == handle ||
+			reinterpret_cast<uint64_t>(binding.View) == handle ||
+			reinterpret_cast<uint64_t>(binding.Sampler) == handle)
+			return true;
+	}
+	return false;
+}
+
+size_t VulkanDescriptorAllocator::Key::Hash() const
+{
+	// FNV-1a over the words
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint64_t word)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	};
+
+	mix(reinterpret_cast<uint64_t>(Layout));
+	for (uint32_t i = 0; i < Count; i++)
+	{
+		const DescriptorBinding& binding = Bindings[i];
+		mix((static_cast<uint64_t>(binding.Binding) << 32) | static_cast<uint64_t>(binding.Type));
+		mix(reinterpret_cast<uint64_t>(binding.Buffer));
+		mix(binding.Offset);
+		mix(binding.Range);
+		mix(reinterpret_cast<uint64_t>(binding.View));
+		mix(reinterpret_cast<uint64_t>(binding.Sampler));
+		mix(binding.Layout);
+	}
+	return static_cast<size_t>(hash);
+}
+
+const VulkanDescriptorAllocator::Entry* VulkanDescriptorAllocator::SetTable::Find(const Key& key, size_t hash) const
+{
+	if (Slots.empty())
+		return nullptr;
+
+	size_t mask = Slots.size() - 1;
+	for (size_t slot = hash & mask; Slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const Entry& entry = Entries[Slots[slot] - 1];
+		if (entry.Hash == hash && entry.Request == key)
+			return &entry;
+	}
+	return nullptr;
+}
+
+void VulkanDescriptorAllocator::SetTable::Insert(const Entry& entry)
+{
+	Entries.push_back(entry);
+	if (Entries.size() * 2 > Slots.size())
+	{
+		Rehash();
+	}
+	else
+	{
+		Place(static_cast<uint32_t>(Entries.size() - 1));
+	}
+}
+
+void VulkanDescriptorAllocator::SetTable::Clear()
+{
+	Entries.clear();
+	std::fill(Slots.begin(), Slots.end(), 0);
+}
+
+void VulkanDescriptorAllocator::SetTable::Rehash()
+{
+	size_t size = Slots.empty() ? 64 : Slots.size();
+	while (Entries.size() * 2 > size)
+	{
+		size *= 2;
+	}
+
+	Slots.assign(size, 0);
+	for (uint32_t i = 0; i < Entries.size(); i++)
+	{
+		Place(i);
+	}
+}
+
+void VulkanDescriptorAllocator::SetTable::Place(uint32_t index)
+{
+	size_t mask = Slots.size() - 1;
+	size_t slot = Entries[index].Hash & mask;
+	while (Slots[slot] != 0)
+	{
+		slot = (slot + 1) & mask;
+	}
+	Slots[slot] = index + 1;
+}
+
+VulkanDescriptorAllocator::VulkanDescriptorAllocator()
+{
+}
+
+void VulkanDescriptorAllocator::Create()
+{
+	Frames.resize(Device->FramesAhead);
+	for (Pools& pools : Frames)
+	{
+		pools.NextSize = FIRST_POOL_SETS;
+	}
+	Persistent.NextSize = FIRST_POOL_SETS;
+	Persistent.Flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+}
+
+void VulkanDescriptorAllocator::Destroy()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	auto destroy = [this](std::vector<VkDescriptorPool>& pools)
+	{
+		for (VkDescriptorPool pool : pools)
+		{
+			vkDestroyDescriptorPool(Device->Device, pool, nullptr);
+		}
+		pools.clear();
+	};
+
+	for (Pools& pools : Frames)
+	{
+		destroy(pools.Pools);
+		pools.Sets.Clear();
+	}
+	destroy(Persistent.Pools); // Takes its pending frees with it
+	Persistent.Sets.Clear();
+	PendingFrees.clear();
+}
+
+void VulkanDescriptorAllocator::BeginFrame(uint32_t frame)
+{
+	PROFILE_SCOPE("DescriptorAllocator::BeginFrame");
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	CurrentFrame = frame;
+
+	// Only pools that were used, a reset is cheap but not free
+	Pools& pools = Frames[frame];
+	uint32_t used = std::min(pools.Current + 1, static_cast<uint32_t>(pools.Pools.size()));
+	for (uint32_t i = 0; i < used; i++)
+	{
+		vkResetDescriptorPool(Device->Device, pools.Pools[i], 0);
+	}
+	pools.Current = 0;
+	pools.Sets.Clear();
+
+	size_t freed = 0;
+	for (; freed < PendingFrees.size() && Device->IsFrameRetired(PendingFrees[freed].Frame); freed++)
+	{
+		vkFreeDescriptorSets(Device->Device, PendingFrees[freed].Pool, 1, &PendingFrees[freed].Set);
+	}
+	if (freed > 0)
+	{
+		PendingFrees.erase(PendingFrees.begin(), PendingFrees.begin() + freed);
+		Persistent.Current = 0; // Earlier pools have room again
+	}
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return AllocateFrom(Frames[CurrentFrame], layout);
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::Allocate(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return GetOrWrite(Frames[CurrentFrame], layout, bindings, count);
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::GetPersistent(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return GetOrWrite(Persistent, layout, bindings, count);
+}
+
+void VulkanDescriptorAllocator::ReleaseHandle(uint64_t handle)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	std::vector<Entry>& entries = Persistent.Sets.Entries;
+	size_t kept = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].Request.Uses(handle))
+		{
+			PendingFree pending;
+			pending.Set = entries[i].Set;
+			pending.Pool = entries[i].Pool;
+			pending.Frame = Device->FrameCount;
+			PendingFrees.push_back(pending);
+		}
+		else
+		{
+			entries[kept++] = entries[i];
+		}
+	}
+
+	if (kept != entries.size())
+	{
+		entries.resize(kept);
+		Persistent.Sets.Rehash();
+	}
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::AllocateFrom(Pools& pools, VkDescriptorSetLayout layout, VkDescriptorPool* pool)
+{
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &layout;
+
+	while (true)
+	{
+		bool created = false;
+		if (pools.Current == pools.Pools.size())
+		{
+			pools.Pools.push_back(CreatePool(pools.NextSize, pools.Flags));
+			pools.NextSize = std::min(pools.NextSize * 2, MAX_POOL_SETS);
+			created = true;
+		}
+
+		allocateInfo.descriptorPool = pools.Pools[pools.Current];
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(Device->Device, &allocateInfo, &set);
+		if (result == VK_SUCCESS)
+		{
+			if (pool != nullptr)
+			{
+				*pool = allocateInfo.descriptorPool;
+			}
+			return set;
+		}
+
+		// Full, the next pool (or a new one) takes it. Anything else is a real failure, and so is a new pool
+		// that can't hold the set, every pool after it would fail the same way.
+		CRITICAL_ASSERT(result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL, "Failed to allocate descriptor set");
+		CRITICAL_ASSERT(!created, "Descriptor set layout doesn't fit in an empty pool, it needs more descriptors than CreatePool provides");
+		pools.Current++;
+	}
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::GetOrWrite(Pools& pools, VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count)
+{
+	CRITICAL_ASSERT(count <= MAX_KEY_BINDINGS, "Descriptor set with %u bindings, at most %u are supported", count, MAX_KEY_BINDINGS);
+
+	Entry entry;
+	entry.Request = MakeKey(layout, bindings, count);
+	entry.Hash = entry.Request.Hash();
+
+	const Entry* existing = pools.Sets.Find(entry.Request, entry.Hash);
+	if (existing != nullptr)
+		return existing->Set;
+
+	entry.Set = AllocateFrom(pools, layout, &entry.Pool);
+
+	VkDescriptorBufferInfo bufferInfos[MAX_KEY_BINDINGS] = {};
+	VkDescriptorImageInfo imageInfos[MAX_KEY_BINDINGS] = {};
+	VkWriteDescriptorSet writes[MAX_KEY_BINDINGS] = {};
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const DescriptorBinding& binding = bindings[i];
+
+		VkWriteDescriptorSet& write = writes[i];
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = entry.Set;
+		write.dstBinding = binding.Binding;
+		write.descriptorCount = 1;
+		write.descriptorType = binding.Type;
+
+		if (binding.Buffer != VK_NULL_HANDLE)
+		{
+			bufferInfos[i].buffer = binding.Buffer;
+			bufferInfos[i].offset = binding.Offset;
+			bufferInfos[i].range = binding.Range;
+			write.pBufferInfo = &bufferInfos[i];
+		}
+		else
+		{
+			imageInfos[i].imageView = binding.View;
+			imageInfos[i].sampler = binding.Sampler;
+			imageInfos[i].imageLayout = binding.Layout;
+			write.pImageInfo = &imageInfos[i];
+		}
+	}
+
+	vkUpdateDescriptorSets(Device->Device, count, writes, 0, nullptr);
+
+	pools.Sets.Insert(entry);
+	return entry.Set;
+}
+
+VkDescriptorPool VulkanDescriptorAllocator::CreatePool(uint32_t sets, VkDescriptorPoolCreateFlags flags)
+{
+	// Rough mix of what a set holds, a pool that runs out of one type early just hands over to the next
+	VkDescriptorPoolSize poolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sets },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, sets },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sets * 4 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, sets },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sets * 2 },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, sets },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, sets },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, sets }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = flags;
+	poolInfo.maxSets = sets;
+	poolInfo.poolSizeCount = sizeof(poolSizes) / sizeof(poolSizes[0]);
+	poolInfo.pPoolSizes = poolSizes;
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(Device->Device, &poolInfo, nullptr, &pool);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create descriptor pool");
+
+	LOG_VK("Descriptor allocator: new pool for %u sets", sets);
+	return pool;
+}
+
+VulkanDescriptorAllocator::Key VulkanDescriptorAllocator::MakeKey(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count)
+{
+	Key key;
+	key.Layout = layout;
+	key.Count = count;
+	std::copy(bindings, bindings + count, key.Bindings);
+	return key;
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// What goes into one binding of a set, buffer or image side depending on Type
+struct DescriptorBinding
+{
+	uint32_t Binding = 0;
+	VkDescriptorType Type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Range = VK_WHOLE_SIZE;
+
+	VkImageView View = VK_NULL_HANDLE;
+	VkSampler Sampler = VK_NULL_HANDLE;
+	VkImageLayout Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	static DescriptorBinding MakeBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	static DescriptorBinding MakeImage(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout);
+};
+
+// Descriptor sets without per set frees. Frame sets come from pools owned by the frame in flight and are
+// reset wholesale once its fence has signaled; pools are added (twice as big each time) when a frame needs
+// more, after that every frame fits without new pools. Identical requests inside a frame share a set, and
+// persistent sets are cached by layout and bindings, so getting those again is a hash lookup with no driver calls
+// and no allocations.
+class VulkanDescriptorAllocator
+{
+public:
+	VulkanDescriptorAllocator();
+
+	class VulkanDevice* Device;
+
+	void Create();
+	void Destroy();
+
+	// After the frame's fence was waited on
+	void BeginFrame(uint32_t frame);
+
+	// Thread safe. Valid until the current frame retires, unwritten.
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+	// Thread safe. Valid until the current frame retires.
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+
+	// Thread safe. Lives until ReleasePersistent is called for one of its resources, which have to outlive it.
+	// The cache is keyed on the raw handles, and a destroyed buffer or view's handle value can come back for a
+	// new resource, which would then get the old set. So whoever destroys a bound resource releases it first.
+	VkDescriptorSet GetPersistent(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+
+	// Thread safe. Drops the persistent sets that bind resource (a buffer, image view or sampler), they are
+	// freed once the frames in flight are done with them. Sets of other owners are left alone.
+	template <typename Handle>
+	void ReleasePersistent(Handle resource)
+	{
+		ReleaseHandle(reinterpret_cast<uint64_t>(resource));
+	}
+
+protected:
+	const uint32_t FIRST_POOL_SETS = 64;
+	const uint32_t MAX_POOL_SETS = 4096;
+	static const uint32_t MAX_KEY_BINDINGS = 8;
+
+	// Inline so lookups never touch the heap
+	struct Key
+	{
+		VkDescriptorSetLayout Layout = VK_NULL_HANDLE;
+		uint32_t Count = 0;
+		DescriptorBinding Bindings[MAX_KEY_BINDINGS];
+
+		bool operator==(const Key& other) const;
+		bool Uses(uint64_t handle) const;
+		size_t Hash() const;
+	};
+
+	struct Entry
+	{
+		Key Request;
+		size_t Hash = 0;
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+		VkDescriptorPool Pool = VK_NULL_HANDLE;
+	};
+
+	// Open addressing over a dense entry array, both keep their capacity through Clear so a frame
+	// that writes no more sets than the ones before it allocates nothing
+	class SetTable
+	{
+	public:
+		std::vector<Entry> Entries;
+
+		const Entry* Find(const Key& key, size_t hash) const;
+		void Insert(const Entry& entry);
+		void Clear();
+		void Rehash(); // After Entries was changed directly
+
+	private:
+		std::vector<uint32_t> Slots; // Entry index + 1, 0 is empty. Power of two size, at most half full.
+
+		void Place(uint32_t index);
+	};
+
+	struct Pools
+	{
+		std::vector<VkDescriptorPool> Pools;
+		uint32_t Current = 0; // Pools before this one are full
+		uint32_t NextSize = 0; // Sets in the next pool created
+		VkDescriptorPoolCreateFlags Flags = 0;
+		SetTable Sets; // Written sets handed out from these pools
+	};
+
+	struct PendingFree
+	{
+		VkDescriptorSet Set = VK_NULL_HANDLE;
+		VkDescriptorPool Pool = VK_NULL_HANDLE;
+		uint64_t Frame = 0;
+	};
+
+	std::vector<Pools> Frames; // Per frame in flight
+	Pools Persistent; // Sets are freed one by one, so its pools allow that
+	std::vector<PendingFree> PendingFrees; // In release order
+
+	uint32_t CurrentFrame = 0;
+
+	std::mutex Mutex;
+
+	void ReleaseHandle(uint64_t handle);
+
+	// Require Mutex
+	VkDescriptorSet AllocateFrom(Pools& pools, VkDescriptorSetLayout layout, VkDescriptorPool* pool = nullptr);
+	VkDescriptorSet GetOrWrite(Pools& pools, VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+	VkDescriptorPool CreatePool(uint32_t sets, VkDescriptorPoolCreateFlags flags);
+
+	static Key MakeKey(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+};
\ No newline at end of file
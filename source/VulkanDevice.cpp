@@ -2,20 +2,44 @@
 
 #include "Common.h"
 #include "Engine.h"
+#include "File.h"
+#include "CpuProfiler.h"
 
 #include "SDL2/SDL_vulkan.h"
 
 #include <set>
+#include <algorithm>
 
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
 
 VkInstance VulkanDevice::Instance = VK_NULL_HANDLE;
+thread_local VkCommandBuffer VulkanDevice::RecordingTarget = VK_NULL_HANDLE;
 
 VulkanDevice::VulkanDevice()
 {
 }
 
+void VulkanDevice::SetPresentProfile(PresentProfile profile, uint32_t framesAhead, uint32_t imageCount)
+{
+	CRITICAL_ASSERT(Device == VK_NULL_HANDLE, "Present profile has to be set before initialization");
+
+	Profile = profile;
+
+	if (framesAhead == 0)
+	{
+		switch (profile)
+		{
+		case PresentProfile::LowLatency: framesAhead = 1; break;
+		case PresentProfile::MaxThroughput: framesAhead = 3; break;
+		case PresentProfile::PowerSaving: framesAhead = 2; break;
+		}
+	}
+
+	FramesAhead = framesAhead;
+	Swapchain.DesiredImageCount = imageCount;
+}
+
 void VulkanDevice::Initialize(SDL_Window* window)
 {
 	Window = window;
@@ -24,18 +48,30 @@ void VulkanDevice::Initialize(SDL_Window* window)
 
 	CreateInstance();
 	SDL_Vulkan_CreateSurface(Window, Instance, &Surface);
+	SDL_Vulkan_GetDrawableSize(Window, &windowWidth, &windowHeight);
+
+	CreateResources();
+}
+
+void VulkanDevice::InitializeHeadless(uint32_t width, uint32_t height)
+{
+	Headless = true;
+
+	windowWidth = static_cast<int32_t>(width);
+	windowHeight = static_cast<int32_t>(height);
+
+	CreateInstance();
+
+	CreateResources();
+}
+
+void VulkanDevice::CreateResources()
+{
 	SelectDevice();
 	CreateDevice();
 	CreateSyncPrimitives();
 	CreateCommandBuffers();
-
-	// Swapchain
-	SDL_Vulkan_GetDrawableSize(Window, &windowWidth, &windowHeight);
-
-	Swapchain.Device = this;
-	Swapchain.Surface = Surface;
-	//Swapchain.PresentQueue = PresentQueue;
-	Swapchain.Create(windowWidth, windowHeight);
+	LoadPipelineCache();
 
 	// Memory Allocator
 	VmaAllocatorCreateInfo allocatorInfo = {};
@@ -46,16 +82,110 @@ void VulkanDevice::Initialize(SDL_Window* window)
 
 	VkResult result = vmaCreateAllocator(&allocatorInfo, &Allocator);
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create memory allocator");
+
+	Layouts.Device = this;
+	Pipelines.Device = this;
+
+	Uploader.Device = this;
+	Uploader.Create();
+
+	Geometry.Device = this;
+	Geometry.Create();
+
+	FrameAllocator.Device = this;
+	FrameAllocator.Create(FRAME_ALLOCATOR_SIZE);
+
+	Descriptors.Device = this;
+	Descriptors.Create();
+
+	Profiler.Device = this;
+	Profiler.Create();
+
+	RenderQueue.Device = this;
+
+	// Before any pipeline, layouts with the bindless set refer to its layout
+	Bindless.Device = this;
+	Bindless.Create();
+
+	// Swapchain (offscreen images when headless, so needs the allocator)
+	Swapchain.Device = this;
+	Swapchain.Surface = Surface;
+	//Swapchain.PresentQueue = PresentQueue;
+	Swapchain.Create(windowWidth, windowHeight);
+}
+
+void VulkanDevice::Shutdown()
+{
+	Uploader.Destroy();
+	Geometry.Destroy();
+	FrameAllocator.Destroy();
+	Descriptors.Destroy();
+	Profiler.Destroy();
+	Pipelines.Destroy();
+	Layouts.Destroy();
+	Bindless.Destroy();
+
+	for (std::vector<WorkerPool>& frame : WorkerPools)
+	{
+		for (WorkerPool& worker : frame)
+		{
+			vkDestroyCommandPool(Device, worker.Pool, nullptr);
+		}
+	}
+	WorkerPools.clear();
+
+	Swapchain.Destroy();
+
+	SavePipelineCache();
+
+	vkDestroyPipelineCache(Device, PipelineCache, nullptr);
+	PipelineCache = VK_NULL_HANDLE;
 }
 
-void VulkanDevice::BeginFrame(VkBuffer Buffer, VkBuffer IndexBuffer, size_t indsiz, VulkanPipeline* pipe)
+bool VulkanDevice::BeginFrame()
 {
-	vkWaitForFences(Device, 1, &Fences[CurrentFrame], VK_TRUE, UINT64_MAX);
+	PROFILE_SCOPE("BeginFrame");
+
+	{
+		PROFILE_SCOPE("vkWaitForFences");
+		vkWaitForFences(Device, 1, &Fences[CurrentFrame], VK_TRUE, UINT64_MAX);
+	}
+
+	Geometry.BeginFrame();
+	Bindless.BeginFrame();
+
+	bool acquired;
+	{
+		PROFILE_SCOPE("NextImage");
+		acquired = Swapchain.NextImage(ImageAvailableSemaphores[CurrentFrame]);
+	}
+
+	// Fence stays signaled if we bail out here, so skipping the frame doesn't deadlock the next one
+	if (!acquired)
+	{
+		return false;
+	}
+
 	vkResetFences(Device, 1, &Fences[CurrentFrame]);
 
-	uint32_t imageIndex = Swapchain.NextImage(ImageAvailableSemaphores[CurrentFrame]);
+	FrameAllocator.BeginFrame(CurrentFrame);
+	Descriptors.BeginFrame(CurrentFrame);
+	RenderQueue.Reset();
+
+	// Secondaries from FramesAhead frames ago are done, recycle them all at once
+	if (!WorkerPools.empty())
+	{
+		for (WorkerPool& worker : WorkerPools[CurrentFrame])
+		{
+			if (worker.Used > 0)
+			{
+				vkResetCommandPool(Device, worker.Pool, 0);
+				worker.Used = 0;
+			}
+		}
+	}
+	SecondariesExecuted = false;
 
-	// Main (Swapchain) Render Pass
 	// Cmd buffer
 	vkResetCommandBuffer(CommandBuffers[CurrentFrame], 0);
 
@@ -65,71 +195,338 @@ void VulkanDevice::BeginFrame(VkBuffer Buffer, VkBuffer IndexBuffer, size_t inds
 	VkResult result = vkBeginCommandBuffer(CommandBuffers[CurrentFrame], &bufferInfo);
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to start command buffer recording");
 
+	Profiler.BeginFrame(CommandBuffers[CurrentFrame]);
+
+	// Kick off pending uploads, acquire barriers have to land outside the render pass
+	Uploader.Submit(CommandBuffers[CurrentFrame]);
+
+	return true;
+}
+
+void VulkanDevice::BeginMainPass()
+{
+	// Main (Swapchain) Render Pass
+	uint32_t imageIndex = Swapchain.CurrentImage;
+
 	constexpr float gray = 16.0f / 255.0f;
-	VkClearValue clearColor = { {{gray, gray, gray, 1.0f }} };
+	VkClearValue clearValues[2] = {};
+	clearValues[0].color = { {gray, gray, gray, 1.0f } };
+	clearValues[1].depthStencil = { 1.0f, 0 };
 
 	VkRenderPassBeginInfo passInfo = {};
 	passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	passInfo.renderPass = Swapchain.RenderPass;
 	passInfo.framebuffer = Swapchain.Framebuffers[imageIndex];
+	CurrentFramebuffer = passInfo.framebuffer;
 	passInfo.renderArea.offset = { 0, 0 };
 	passInfo.renderArea.extent = Swapchain.Extent;
-	passInfo.clearValueCount = 1;
-	passInfo.pClearValues = &clearColor;
+	passInfo.clearValueCount = Swapchain.UseDepth ? 2 : 1;
+	passInfo.pClearValues = clearValues;
+
+	// Outside the pass, the primary can't record anything but vkCmdExecuteCommands inside it with secondaries
+	Profiler.BeginZone(CommandBuffers[CurrentFrame], "Main Pass");
+
+	if (ParallelRecording)
+	{
+		vkCmdBeginRenderPass(CommandBuffers[CurrentFrame], &passInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		return; // Pipelines and dynamic state get set per secondary
+	}
 
 	vkCmdBeginRenderPass(CommandBuffers[CurrentFrame], &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	vkCmdBindPipeline(CommandBuffers[CurrentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->Pipeline);
+	SetViewport(CommandBuffers[CurrentFrame]);
 }
 
 void VulkanDevice::Present()
 {
+	PROFILE_SCOPE("Present");
+
+	if (ParallelRecording && !SecondariesExecuted)
+	{
+		ExecuteSecondaries();
+	}
+
 	vkCmdEndRenderPass(CommandBuffers[CurrentFrame]);
+	Profiler.EndZone(CommandBuffers[CurrentFrame]);
+
+	Profiler.EndFrame(CommandBuffers[CurrentFrame]);
 
 	VkResult result = vkEndCommandBuffer(CommandBuffers[CurrentFrame]);
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to end command buffer recording");
 
-	VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	FrameAllocator.Flush();
+
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStages[2];
+	uint32_t waitCount = 0;
+
+	// Offscreen images are never acquired or presented, so there is nothing to wait on or signal
+	if (!Headless)
+	{
+		waitSemaphores[waitCount] = ImageAvailableSemaphores[CurrentFrame];
+		waitStages[waitCount] = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		waitCount++;
+	}
+
+	if (Uploader.WaitSemaphore != VK_NULL_HANDLE)
+	{
+		waitSemaphores[waitCount] = Uploader.WaitSemaphore;
+		waitStages[waitCount] = Uploader.WaitStages;
+		waitCount++;
+	}
 
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pWaitDstStageMask = &stageFlags;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &ImageAvailableSemaphores[CurrentFrame];
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &CommandBuffers[CurrentFrame];
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &RenderFinishedSemaphores[CurrentFrame];
 
-    result = vkQueueSubmit(GraphicsQueue, 1, &submitInfo, Fences[CurrentFrame]);
-	CRITICAL_ASSERT(result == VK_SUCCESS, "Queue submission failed");
+	if (!Headless)
+	{
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &RenderFinishedSemaphores[CurrentFrame];
+	}
+
+	Profiler.MarkSubmit();
+
+	{
+		PROFILE_SCOPE("vkQueueSubmit");
+		result = vkQueueSubmit(GraphicsQueue, 1, &submitInfo, Fences[CurrentFrame]);
+		CRITICAL_ASSERT(result == VK_SUCCESS, "Queue submission failed");
+	}
+
+	{
+		PROFILE_SCOPE("vkQueuePresentKHR");
+		Swapchain.Present(RenderFinishedSemaphores[CurrentFrame]);
+	}
+
+	CurrentFrame = (CurrentFrame + 1) % FramesAhead;
+	FrameCount++;
+}
 
-	Swapchain.Present(RenderFinishedSemaphores[CurrentFrame]);
-	CurrentFrame = (CurrentFrame + 1) % MAX_FRAMES_AHEAD;
+void VulkanDevice::BindVertexBuffer(const VulkanBuffer* const buffer, VkDeviceSize offset)
+{
+	vkCmdBindVertexBuffers(GetCommandBuffer(), 0, 1, &buffer->Buffer, &offset);
 }
 
-void VulkanDevice::BindVertexBuffer(const VulkanBuffer* const buffer)
+void VulkanDevice::BindVertexBuffer(const FrameAllocation& allocation)
 {
-	// TODO: No offset stuff yet
-	VkDeviceSize offsets = { 0 };
-	vkCmdBindVertexBuffers(CommandBuffers[CurrentFrame], 0, 1, &buffer->Buffer, &offsets);
+	VkDeviceSize offset = allocation.Offset;
+	vkCmdBindVertexBuffers(GetCommandBuffer(), 0, 1, &allocation.Buffer, &offset);
 }
 
 void VulkanDevice::BindIndexBuffer(const VulkanBuffer* const buffer)
 {
-	// TODO: Support different index buffer data type (u16 and u32 mainly i guess)
-	vkCmdBindIndexBuffer(CommandBuffers[CurrentFrame], buffer->Buffer, 0, VK_INDEX_TYPE_UINT16);
+	vkCmdBindIndexBuffer(GetCommandBuffer(), buffer->Buffer, 0, buffer->IndexType);
 }
 
 void VulkanDevice::BindPipeline(const VulkanPipeline* const pipeline)
 {
-	vkCmdBindPipeline(CommandBuffers[CurrentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->Pipeline);
+	vkCmdBindPipeline(GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->Pipeline);
+}
+
+void VulkanDevice::BindFrameAllocation(const VulkanPipeline* const pipeline, uint32_t set, const FrameAllocation& allocation)
+{
+	VkDescriptorSet descriptorSet = allocation.Usage == FrameUsage::Storage ? FrameAllocator.StorageSet : FrameAllocator.UniformSet;
+	vkCmdBindDescriptorSets(GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->PipelineLayout, set, 1, &descriptorSet, 1, &allocation.Offset);
+}
+
+void VulkanDevice::BindBindless(const VulkanPipeline* const pipeline)
+{
+	Bindless.Bind(GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->PipelineLayout);
+}
+
+void VulkanDevice::PushConstants(const VulkanPipeline* const pipeline, const void* data, uint32_t size)
+{
+	vkCmdPushConstants(GetCommandBuffer(), pipeline->PipelineLayout, VulkanLayoutCache::Stages, 0, size, data);
+}
+
+void VulkanDevice::BindGeometry(const GeometryHandle& geometry)
+{
+	BindVertexBuffer(geometry.VertexBuffer);
+	BindIndexBuffer(geometry.IndexBuffer);
+}
+
+void VulkanDevice::BindInstanceBuffer(const VulkanBuffer* const buffer, VkDeviceSize offset)
+{
+	vkCmdBindVertexBuffers(GetCommandBuffer(), 1, 1, &buffer->Buffer, &offset);
+}
+
+void VulkanDevice::BindInstanceBuffer(const FrameAllocation& allocation)
+{
+	VkDeviceSize offset = allocation.Offset;
+	vkCmdBindVertexBuffers(GetCommandBuffer(), 1, 1, &allocation.Buffer, &offset);
+}
+
+FrameAllocation VulkanDevice::StreamInstances(const void* data, uint32_t count, uint32_t stride)
+{
+	FrameAllocation allocation = FrameAllocator.Allocate(static_cast<VkDeviceSize>(count) * stride, FrameUsage::Vertex);
+	memcpy(allocation.Data, data, static_cast<size_t>(allocation.Size));
+
+	BindInstanceBuffer(allocation);
+	return allocation;
+}
+
+void VulkanDevice::DrawIndexed(size_t count, uint32_t firstIndex, int32_t vertexOffset)
+{
+	vkCmdDrawIndexed(GetCommandBuffer(), static_cast<uint32_t>(count), 1, firstIndex, vertexOffset, 0);
 }
 
-void VulkanDevice::DrawIndexed(size_t size)
+void VulkanDevice::DrawIndexedInstanced(size_t count, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
 {
-	// TODO: whole buffer size helper method doesnt take size
-	vkCmdDrawIndexed(CommandBuffers[CurrentFrame], static_cast<uint32_t>(size), 1, 0, 0, 0);
+	vkCmdDrawIndexed(GetCommandBuffer(), static_cast<uint32_t>(count), instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void VulkanDevice::DrawGeometry(const GeometryHandle& geometry, uint32_t instanceCount, uint32_t firstInstance)
+{
+	vkCmdDrawIndexed(GetCommandBuffer(), geometry.IndexCount, instanceCount, geometry.FirstIndex, geometry.VertexOffset, firstInstance);
+}
+
+void VulkanDevice::Resize()
+{
+	if (!Headless)
+	{
+		Swapchain.OutOfDate = true;
+	}
+}
+
+void VulkanDevice::SetViewport(VkCommandBuffer commandBuffer)
+{
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(Swapchain.Extent.width);
+	viewport.height = static_cast<float>(Swapchain.Extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = Swapchain.Extent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+VkCommandBuffer VulkanDevice::GetCommandBuffer() const
+{
+	return RecordingTarget != VK_NULL_HANDLE ? RecordingTarget : CommandBuffers[CurrentFrame];
+}
+
+bool VulkanDevice::IsFrameRetired(uint64_t frame) const
+{
+	return frame + FramesAhead <= FrameCount;
+}
+
+void VulkanDevice::CreateWorkerPools(uint32_t workerCount)
+{
+	CRITICAL_ASSERT(WorkerPools.empty(), "Worker pools already created");
+
+	VkCommandPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	createInfo.queueFamilyIndex = GraphicsFamily;
+	createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Reset as a whole each frame
+
+	WorkerPools.resize(FramesAhead);
+	for (std::vector<WorkerPool>& frame : WorkerPools)
+	{
+		frame.resize(workerCount);
+		for (WorkerPool& worker : frame)
+		{
+			VkResult result = vkCreateCommandPool(Device, &createInfo, nullptr, &worker.Pool);
+			CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create worker command pool");
+		}
+	}
+}
+
+VkCommandBuffer VulkanDevice::BeginSecondary(uint32_t worker, uint32_t order)
+{
+	CRITICAL_ASSERT(!WorkerPools.empty(), "Worker pools haven't been created");
+	CRITICAL_ASSERT(worker < WorkerPools[CurrentFrame].size(), "Invalid worker index %u", worker);
+	CRITICAL_ASSERT(RecordingTarget == VK_NULL_HANDLE, "Secondary already being recorded on this thread");
+
+	WorkerPool& pool = WorkerPools[CurrentFrame][worker];
+	if (pool.Used == pool.Buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocation = {};
+		allocation.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocation.commandPool = pool.Pool;
+		allocation.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocation.commandBufferCount = 1;
+
+		VkCommandBuffer buffer;
+		VkResult result = vkAllocateCommandBuffers(Device, &allocation, &buffer);
+		CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate secondary command buffer");
+
+		pool.Buffers.push_back(buffer);
+		pool.Orders.push_back(0);
+	}
+
+	pool.Orders[pool.Used] = order;
+	VkCommandBuffer buffer = pool.Buffers[pool.Used++];
+
+	VkCommandBufferInheritanceInfo inheritance = {};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = Swapchain.RenderPass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = CurrentFramebuffer;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	VkResult result = vkBeginCommandBuffer(buffer, &beginInfo);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to start secondary command buffer recording");
+
+	// Dynamic state isn't inherited from the primary
+	SetViewport(buffer);
+
+	RecordingTarget = buffer;
+	return buffer;
+}
+
+void VulkanDevice::EndSecondary()
+{
+	CRITICAL_ASSERT(RecordingTarget != VK_NULL_HANDLE, "No secondary being recorded on this thread");
+
+	VkResult result = vkEndCommandBuffer(RecordingTarget);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to end secondary command buffer recording");
+
+	RecordingTarget = VK_NULL_HANDLE;
+}
+
+void VulkanDevice::ExecuteSecondaries()
+{
+	// Collected in worker order, then recording order within a worker, the stable sort keeps that for equal orders
+	OrderedSecondaries.clear();
+	for (const WorkerPool& worker : WorkerPools[CurrentFrame])
+	{
+		for (uint32_t i = 0; i < worker.Used; i++)
+		{
+			OrderedSecondaries.push_back({ worker.Orders[i], worker.Buffers[i] });
+		}
+	}
+
+	std::stable_sort(OrderedSecondaries.begin(), OrderedSecondaries.end(), [](const OrderedSecondary& a, const OrderedSecondary& b)
+	{
+		return a.Order < b.Order;
+	});
+
+	SecondaryBuffers.clear();
+	for (const OrderedSecondary& secondary : OrderedSecondaries)
+	{
+		SecondaryBuffers.push_back(secondary.Buffer);
+	}
+
+	if (!SecondaryBuffers.empty())
+	{
+		vkCmdExecuteCommands(CommandBuffers[CurrentFrame], static_cast<uint32_t>(SecondaryBuffers.size()), SecondaryBuffers.data());
+	}
+
+	SecondariesExecuted = true;
 }
 
 void VulkanDevice::CreateInstance()
@@ -142,13 +539,20 @@ void VulkanDevice::CreateInstance()
 	applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	applicationInfo.pApplicationName = "Daedalus";
 	applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-	applicationInfo.apiVersion = VK_API_VERSION_1_0;
+	applicationInfo.apiVersion = VK_API_VERSION_1_1; // For vkGetPhysicalDeviceFeatures2
 
+	// Headless instances don't need any surface extensions
 	uint32_t extensionCount = 0;
-	SDL_Vulkan_GetInstanceExtensions(Window, &extensionCount, nullptr);
+	if (!Headless)
+	{
+		SDL_Vulkan_GetInstanceExtensions(Window, &extensionCount, nullptr);
+	}
 
 	std::vector<const char*> extensions(extensionCount);
-	SDL_Vulkan_GetInstanceExtensions(Window, &extensionCount, extensions.data());
+	if (!Headless)
+	{
+		SDL_Vulkan_GetInstanceExtensions(Window, &extensionCount, extensions.data());
+	}
 
 	for (const char* extension : AdditionalExtensions)
 	{
@@ -192,6 +596,7 @@ void VulkanDevice::SelectDevice()
 	}
 
 	PhysicalDevice = devices[0];
+	vkGetPhysicalDeviceProperties(PhysicalDevice, &Properties);
 	LOG_VK("First physical device selected");
 }
 
@@ -213,8 +618,16 @@ void VulkanDevice::CreateDevice()
 
 		bool isGraphicsFamily = family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
 
+		// Without a surface nothing is presented, so the graphics family stands in for present
 		VkBool32 supportsPresent = VK_FALSE;
-		vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, i, Surface, &supportsPresent);
+		if (Headless)
+		{
+			supportsPresent = isGraphicsFamily ? VK_TRUE : VK_FALSE;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, i, Surface, &supportsPresent);
+		}
 
 		if (isGraphicsFamily && supportsPresent == VK_TRUE)
 		{
@@ -233,9 +646,33 @@ void VulkanDevice::CreateDevice()
 	}
 	CRITICAL_ASSERT(GraphicsFamily != -1 && PresentFamily != -1, "Could not acquire queue families");
 
+	// Prefer a transfer only family (DMA engine), then anything that isn't graphics, then just share graphics
+	TransferFamily = -1;
+	for (uint32_t i = 0; i < queueFamilies.size(); i++)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+			continue;
+
+		if (!(flags & VK_QUEUE_COMPUTE_BIT))
+		{
+			TransferFamily = i;
+			break;
+		}
+		else if (TransferFamily == -1)
+		{
+			TransferFamily = i;
+		}
+	}
+	if (TransferFamily == -1)
+	{
+		TransferFamily = GraphicsFamily;
+	}
+	LOG_VK("Queue families: graphics %d, present %d, transfer %d", GraphicsFamily, PresentFamily, TransferFamily);
+
 	const float queuePriority = 1.0f;
 
-	std::set<int32_t> families = { GraphicsFamily, PresentFamily };
+	std::set<int32_t> families = { GraphicsFamily, PresentFamily, TransferFamily };
 	std::vector<VkDeviceQueueCreateInfo> queueInfos;
 
 	for (int32_t family : families)
@@ -249,14 +686,124 @@ void VulkanDevice::CreateDevice()
 		queueInfos.push_back(queueInfo);
 	}
 
+	// Only what we use, enabling everything can cost performance on some drivers
+	VkPhysicalDeviceFeatures supportedFeatures = {};
+	vkGetPhysicalDeviceFeatures(PhysicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	MultiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+	DrawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+
+	// Software drivers may not expose VK_KHR_swapchain at all, and headless never needs it
+	std::vector<const char*> extensions;
+	if (!Headless)
+	{
+		extensions = DeviceExtensions;
+	}
+
+	uint32_t availableCount = 0;
+	vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &availableCount, nullptr);
+
+	std::vector<VkExtensionProperties> available(availableCount);
+	vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &availableCount, available.data());
+
+	bool indexTypeUint8Available = false;
+	bool descriptorIndexingAvailable = false;
+	for (const VkExtensionProperties& extension : available)
+	{
+		if (strcmp(extension.extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0)
+		{
+			extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+			CalibratedTimestamps = true;
+		}
+		else if (strcmp(extension.extensionName, VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME) == 0)
+		{
+			indexTypeUint8Available = true;
+		}
+		else if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+		{
+			extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			DrawIndirectCount = true;
+		}
+		else if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+		{
+			descriptorIndexingAvailable = true;
+		}
+	}
+
+	// Extension features have to be queried and enabled through pNext chains
+	VkPhysicalDeviceIndexTypeUint8FeaturesEXT indexTypeUint8 = {};
+	indexTypeUint8.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexing = {};
+	supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexing = {};
+	descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	void* featureChain = nullptr;
+	if ((indexTypeUint8Available || descriptorIndexingAvailable) && Properties.apiVersion >= VK_API_VERSION_1_1)
+	{
+		// Only structs of extensions that are there
+		void* queryChain = nullptr;
+		if (indexTypeUint8Available)
+		{
+			indexTypeUint8.pNext = queryChain;
+			queryChain = &indexTypeUint8;
+		}
+		if (descriptorIndexingAvailable)
+		{
+			supportedIndexing.pNext = queryChain;
+			queryChain = &supportedIndexing;
+		}
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = queryChain;
+		vkGetPhysicalDeviceFeatures2(PhysicalDevice, &features);
+
+		if (indexTypeUint8Available && indexTypeUint8.indexTypeUint8)
+		{
+			extensions.push_back(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+			IndexTypeUint8 = true;
+
+			indexTypeUint8.pNext = featureChain;
+			featureChain = &indexTypeUint8;
+		}
+
+		// What the bindless set needs, non uniform indexing is optional since handles mostly come from push constants
+		if (descriptorIndexingAvailable &&
+			supportedIndexing.runtimeDescriptorArray &&
+			supportedIndexing.descriptorBindingPartiallyBound &&
+			supportedIndexing.descriptorBindingUpdateUnusedWhilePending &&
+			supportedIndexing.descriptorBindingSampledImageUpdateAfterBind &&
+			supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind)
+		{
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			DescriptorIndexing = true;
+
+			descriptorIndexing.runtimeDescriptorArray = VK_TRUE;
+			descriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+			descriptorIndexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			descriptorIndexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			descriptorIndexing.shaderSampledImageArrayNonUniformIndexing = supportedIndexing.shaderSampledImageArrayNonUniformIndexing;
+			descriptorIndexing.shaderStorageBufferArrayNonUniformIndexing = supportedIndexing.shaderStorageBufferArrayNonUniformIndexing;
+
+			descriptorIndexing.pNext = featureChain;
+			featureChain = &descriptorIndexing;
+		}
+	}
 
 	VkDeviceCreateInfo deviceInfo = {};
 	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.pNext = featureChain;
 	deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
 	deviceInfo.pQueueCreateInfos = queueInfos.data();
-	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(DeviceExtensions.size());
-	deviceInfo.ppEnabledExtensionNames = DeviceExtensions.data();
+	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	deviceInfo.ppEnabledExtensionNames = extensions.data();
 	deviceInfo.pEnabledFeatures = &deviceFeatures;
 
 	VkResult result = vkCreateDevice(PhysicalDevice, &deviceInfo, nullptr, &Device);
@@ -264,13 +811,24 @@ void VulkanDevice::CreateDevice()
 
 	vkGetDeviceQueue(Device, GraphicsFamily, 0, &GraphicsQueue);
 	vkGetDeviceQueue(Device, PresentFamily, 0, &PresentQueue);
+	vkGetDeviceQueue(Device, TransferFamily, 0, &TransferQueue);
+
+	if (DrawIndirectCount)
+	{
+		CmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+			vkGetDeviceProcAddr(Device, "vkCmdDrawIndexedIndirectCountKHR"));
+		DrawIndirectCount = CmdDrawIndexedIndirectCount != nullptr;
+	}
+
+	LOG_VK("Indirect draws: multi draw %d, first instance %d, draw count %d", MultiDrawIndirect, DrawIndirectFirstInstance, DrawIndirectCount);
+	LOG_VK("Descriptor indexing: %d", DescriptorIndexing);
 }
 
 void VulkanDevice::CreateSyncPrimitives()
 {
-	ImageAvailableSemaphores.resize(MAX_FRAMES_AHEAD);
-	RenderFinishedSemaphores.resize(MAX_FRAMES_AHEAD);
-	Fences.resize(MAX_FRAMES_AHEAD);
+	ImageAvailableSemaphores.resize(FramesAhead);
+	RenderFinishedSemaphores.resize(FramesAhead);
+	Fences.resize(FramesAhead);
 
 	VkSemaphoreCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -279,7 +837,7 @@ void VulkanDevice::CreateSyncPrimitives()
 	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Signaled on start
 
-	for (uint32_t i = 0; i < MAX_FRAMES_AHEAD; i++)
+	for (uint32_t i = 0; i < FramesAhead; i++)
 	{
 		// lol ignore result
 		vkCreateSemaphore(Device, &createInfo, nullptr, &ImageAvailableSemaphores[i]);
@@ -301,7 +859,7 @@ void VulkanDevice::CreateCommandBuffers()
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create command pool");
 
 	// Command Buffers
-	CommandBuffers.resize(MAX_FRAMES_AHEAD); // TODO: consider per swapchain image? why if we only have 2 frames max anyway
+	CommandBuffers.resize(FramesAhead); // Per frame in flight, swapchain image count is configured separately
 
 	VkCommandBufferAllocateInfo allocation = {};
 	allocation.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -311,4 +869,70 @@ void VulkanDevice::CreateCommandBuffers()
 
 	result = vkAllocateCommandBuffers(Device, &allocation, CommandBuffers.data());
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate command buffers");
+}
+
+void VulkanDevice::LoadPipelineCache()
+{
+	std::vector<uint8_t> data;
+	if (File::TryReadAllBytes(PipelineCachePath, data))
+	{
+		// Drivers are supposed to reject foreign caches themselves, but not all of them do
+		VkPipelineCacheHeaderVersionOne header = {};
+		if (data.size() >= sizeof(header))
+		{
+			memcpy(&header, data.data(), sizeof(header));
+		}
+
+		bool valid =
+			data.size() >= sizeof(header) &&
+			header.headerSize >= sizeof(header) &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == Properties.vendorID &&
+			header.deviceID == Properties.deviceID &&
+			memcmp(header.pipelineCacheUUID, Properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+		if (!valid)
+		{
+			LOG_VK("Pipeline cache %s is stale or from another device, ignoring it", PipelineCachePath);
+			data.clear();
+		}
+	}
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	VkResult result = vkCreatePipelineCache(Device, &createInfo, nullptr, &PipelineCache);
+	if (result != VK_SUCCESS && !data.empty())
+	{
+		// Retry empty, a bad cache should never stop us from starting
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(Device, &createInfo, nullptr, &PipelineCache);
+	}
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create pipeline cache");
+
+	LOG_VK("Pipeline cache loaded (%zu bytes)", data.size());
+}
+
+void VulkanDevice::SavePipelineCache()
+{
+	if (PipelineCache == VK_NULL_HANDLE)
+		return;
+
+	size_t size = 0;
+	VkResult result = vkGetPipelineCacheData(Device, PipelineCache, &size, nullptr);
+	if (result != VK_SUCCESS || size == 0)
+		return;
+
+	std::vector<uint8_t> data(size);
+	result = vkGetPipelineCacheData(Device, PipelineCache, &size, data.data());
+	if (result != VK_SUCCESS)
+		return;
+
+	if (!File::WriteAllBytesAtomic(PipelineCachePath, data.data(), size))
+	{
+		LOG_VK("Failed to write pipeline cache %s", PipelineCachePath);
+	}
 }
\ No newline at end of file
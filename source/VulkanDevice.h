@@ -1,8 +1,17 @@
 #pragma once
 
 #include "VulkanSwapChain.h"
+#include "VulkanUploader.h"
+#include "VulkanFrameAllocator.h"
+#include "VulkanProfiler.h"
+#include "VulkanLayoutCache.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanGeometryPool.h"
 #include "VulkanBuffer.h"
 #include "VulkanPipeline.h"
+#include "VulkanRenderQueue.h"
+#include "VulkanBindless.h"
+#include "VulkanDescriptorAllocator.h"
 
 #include "vulkan/vulkan.h"
 #include "vk_mem_alloc.h"
@@ -26,46 +35,132 @@ public:
 	static VkInstance Instance;
 
 	SDL_Window* Window = nullptr;
+	bool Headless = false; // No window or surface, renders into offscreen images instead
 	VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties Properties = {};
 	VkDevice Device = VK_NULL_HANDLE;
 	VkSurfaceKHR Surface = VK_NULL_HANDLE;
 	VmaAllocator Allocator = VK_NULL_HANDLE;
 	VulkanSwapchain Swapchain;
+	VulkanUploader Uploader;
+	VulkanGeometryPool Geometry;
+	VulkanFrameAllocator FrameAllocator;
+	VulkanDescriptorAllocator Descriptors;
+	VulkanProfiler Profiler;
+	VulkanLayoutCache Layouts;
+	VulkanPipelineCache Pipelines;
+	VulkanRenderQueue RenderQueue; // Emptied by BeginFrame
+	VulkanBindless Bindless; // Unavailable without DescriptorIndexing
+	VkPipelineCache PipelineCache = VK_NULL_HANDLE;
 
 	uint32_t CurrentFrame = 0;
+	uint64_t FrameCount = 0; // Total frames submitted
+
+	// Set through SetPresentProfile before Initialize
+	PresentProfile Profile = PresentProfile::MaxThroughput;
+	uint32_t FramesAhead = 2;
 
 	// Queues
 	int32_t GraphicsFamily = -1;
 	int32_t PresentFamily = -1;
+	int32_t TransferFamily = -1;
 
 	VkQueue GraphicsQueue = VK_NULL_HANDLE;
 	VkQueue PresentQueue = VK_NULL_HANDLE;
 	VkQueue TransferQueue = VK_NULL_HANDLE;
 
+	// Optional extensions that were found and enabled
+	bool CalibratedTimestamps = false;
+	bool IndexTypeUint8 = false;
+	bool DrawIndirectCount = false; // VK_KHR_draw_indirect_count, CmdDrawIndexedIndirectCount is loaded
+	bool DescriptorIndexing = false; // VK_EXT_descriptor_indexing with what the bindless set needs
+
+	// Core features that were found and enabled
+	bool MultiDrawIndirect = false;
+	bool DrawIndirectFirstInstance = false;
+
+	PFN_vkCmdDrawIndexedIndirectCountKHR CmdDrawIndexedIndirectCount = nullptr;
+
 	// Command Buffers
 	VkCommandPool CommandPool;
 	std::vector<VkCommandBuffer> CommandBuffers;
 
+	// Parallel recording, the main pass takes secondary command buffers only and all draws
+	// have to be recorded between BeginSecondary/EndSecondary
+	bool ParallelRecording = false;
+
 	// Sync Primitives
 	std::vector<VkSemaphore> ImageAvailableSemaphores;
 	std::vector<VkSemaphore> RenderFinishedSemaphores;
 	std::vector<VkFence> Fences;
 
-	void Initialize(SDL_Window* window);
+	// Picks the present mode and frames in flight, 0 leaves framesAhead/imageCount at the profile's default
+	void SetPresentProfile(PresentProfile profile, uint32_t framesAhead = 0, uint32_t imageCount = 0);
 
-	void BeginFrame(VkBuffer Buffer, VkBuffer IndexBuffer, size_t indsiz, VulkanPipeline* pipe);
+	void Initialize(SDL_Window* window);
+	void InitializeHeadless(uint32_t width, uint32_t height);
+	void Shutdown();
+
+	// Returns false if the frame has to be skipped (minimized window), Present must not be called then.
+	// Work that has to happen outside the main pass (compute, copies) records between BeginFrame and BeginMainPass.
+	bool BeginFrame();
+	// Nothing is bound afterwards, draws bind their own pipeline
+	void BeginMainPass();
 	void Present();
 
-	void BindVertexBuffer(const VulkanBuffer* const buffer);
+	// Window size changed, the swapchain is rebuilt on the next BeginFrame
+	void Resize();
+
+	void BindVertexBuffer(const VulkanBuffer* const buffer, VkDeviceSize offset = 0);
+	void BindVertexBuffer(const FrameAllocation& allocation);
 	void BindIndexBuffer(const VulkanBuffer* const buffer);
 	void BindPipeline(const VulkanPipeline* const pipeline);
+	void BindFrameAllocation(const VulkanPipeline* const pipeline, uint32_t set, const FrameAllocation& allocation);
+
+	// Once per pipeline layout, pipelines sharing a layout keep it bound
+	void BindBindless(const VulkanPipeline* const pipeline);
+	// From offset 0, bindless handles and other small per draw data
+	void PushConstants(const VulkanPipeline* const pipeline, const void* data, uint32_t size);
+
+	// Binds the pool buffers the geometry lives in, every geometry sharing them draws without rebinding
+	void BindGeometry(const GeometryHandle& geometry);
+
+	// Per instance inputs (PipelineDescription::InstanceInputs) are read from binding 1
+	void BindInstanceBuffer(const VulkanBuffer* const buffer, VkDeviceSize offset = 0);
+	void BindInstanceBuffer(const FrameAllocation& allocation);
+
+	// Copies this frame's instance data (transforms, colors, ...) into the frame allocator and binds it, thread safe
+	FrameAllocation StreamInstances(const void* data, uint32_t count, uint32_t stride);
+
+	template <typename T>
+	FrameAllocation StreamInstances(const T* instances, uint32_t count)
+	{
+		return StreamInstances(instances, count, sizeof(T));
+	}
 
-	void DrawIndexed(size_t count);
+	void DrawIndexed(size_t count, uint32_t firstIndex = 0, int32_t vertexOffset = 0);
+	void DrawIndexedInstanced(size_t count, uint32_t instanceCount, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0);
+	void DrawGeometry(const GeometryHandle& geometry, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+	// Bind/Draw calls record into the calling thread's secondary buffer while one is open, the primary otherwise
+	VkCommandBuffer GetCommandBuffer() const;
+
+	// Deferred releases stamp FrameCount, the frame being recorded may still use what they release.
+	// Safe to destroy or reuse once the stamped frame's fence has been waited on.
+	bool IsFrameRetired(uint64_t frame) const;
+
+	// One pool per worker and frame, a worker index must only be used by one thread at a time. Secondaries are
+	// executed by ascending order, ties in worker and then recording order.
+	void CreateWorkerPools(uint32_t workerCount);
+	VkCommandBuffer BeginSecondary(uint32_t worker, uint32_t order = 0);
+	void EndSecondary();
+	void ExecuteSecondaries(); // Join, called by Present if needed
 
 	void SetFramebuffer(); // TODO:
 
 protected:
-	const uint32_t MAX_FRAMES_AHEAD = 2;
+	const char* PipelineCachePath = "pipeline.cache";
+	const VkDeviceSize FRAME_ALLOCATOR_SIZE = 8 * 1024 * 1024; // Per frame in flight
 
 	const std::vector<const char*> AdditionalExtensions =
 	{
@@ -83,9 +178,37 @@ protected:
 	};
 
 	void CreateInstance();
+	void CreateResources();
 
 	void SelectDevice();
 	void CreateDevice();
 	void CreateSyncPrimitives();
 	void CreateCommandBuffers();
+
+	struct WorkerPool
+	{
+		VkCommandPool Pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> Buffers;
+		std::vector<uint32_t> Orders; // Of the used buffers
+		uint32_t Used = 0;
+	};
+
+	struct OrderedSecondary
+	{
+		uint32_t Order;
+		VkCommandBuffer Buffer;
+	};
+
+	std::vector<std::vector<WorkerPool>> WorkerPools; // [frame][worker]
+	std::vector<OrderedSecondary> OrderedSecondaries;
+	std::vector<VkCommandBuffer> SecondaryBuffers;
+	VkFramebuffer CurrentFramebuffer = VK_NULL_HANDLE;
+	bool SecondariesExecuted = false;
+
+	static thread_local VkCommandBuffer RecordingTarget;
+
+	void SetViewport(VkCommandBuffer commandBuffer);
+
+	void LoadPipelineCache();
+	void SavePipelineCache();
 };
\ No newline at end of file
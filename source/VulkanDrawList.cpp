@@ -0,0 +1,309 @@
+#include "VulkanDrawList.h"
+
+#include "Common.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanComputePipeline.h"
+#include "VulkanDepthPyramid.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+VulkanDrawList* VulkanDrawList::Create(VulkanDevice* device, const File::ByteView& buildShader, uint32_t maxObjects, VulkanDepthPyramid* pyramid)
+{
+	// Commands carry the object index as firstInstance, that's what finds the transform
+	CRITICAL_ASSERT(device->DrawIndirectFirstInstance, "Draw lists need the drawIndirectFirstInstance feature");
+
+	VulkanDrawList* list = new VulkanDrawList();
+	list->Device = device;
+	list->MaxObjects = maxObjects;
+	list->Pyramid = pyramid;
+
+	// Set 1 takes the cull data straight from the frame allocator
+	list->BuildPipeline = VulkanComputePipeline::Create(device, buildShader, 1u << 1);
+
+	list->Objects = VulkanBuffer::Create(device, BufferType::Storage, nullptr, sizeof(DrawObject) * maxObjects);
+	list->Transforms = VulkanBuffer::Create(device, BufferType::Storage, nullptr, sizeof(glm::mat4) * maxObjects);
+	list->Commands = VulkanBuffer::Create(device, BufferType::Indirect, nullptr, sizeof(VkDrawIndexedIndirectCommand) * maxObjects);
+	list->Count = VulkanBuffer::Create(device, BufferType::Indirect, nullptr, sizeof(uint32_t));
+
+	list->Records.reserve(maxObjects);
+	list->TransformData.reserve(maxObjects);
+
+	LOG_VK("Draw list: %u objects, %s", maxObjects,
+		device->DrawIndirectCount ? "indirect count" : device->MultiDrawIndirect ? "multi draw indirect" : "single indirect draws");
+
+	return list;
+}
+
+void VulkanDrawList::Destroy(VulkanDevice* device, VulkanDrawList* list)
+{
+	// The build set is persistent and keyed on the buffers
+	device->Descriptors.ReleasePersistent(list->Objects->Buffer);
+	device->Descriptors.ReleasePersistent(list->Transforms->Buffer);
+	device->Descriptors.ReleasePersistent(list->Commands->Buffer);
+	device->Descriptors.ReleasePersistent(list->Count->Buffer);
+
+	VulkanBuffer::Destroy(device, list->Objects);
+	VulkanBuffer::Destroy(device, list->Transforms);
+	VulkanBuffer::Destroy(device, list->Commands);
+	VulkanBuffer::Destroy(device, list->Count);
+
+	VulkanComputePipeline::Destroy(device, list->BuildPipeline);
+
+	delete list;
+}
+
+uint32_t VulkanDrawList::Add(const GeometryHandle& geometry, const glm::mat4& transform, const glm::vec3& center, float radius)
+{
+	if (VertexBuffer == nullptr)
+	{
+		VertexBuffer = geometry.VertexBuffer;
+		IndexBuffer = geometry.IndexBuffer;
+	}
+	CRITICAL_ASSERT(geometry.VertexBuffer == VertexBuffer && geometry.IndexBuffer == IndexBuffer, "Draw list objects have to share their geometry buffers");
+
+	uint32_t object;
+	if (!FreeSlots.empty())
+	{
+		object = FreeSlots.back();
+		FreeSlots.pop_back();
+	}
+	else
+	{
+		CRITICAL_ASSERT(SlotCount < MaxObjects, "Draw list is full (%u objects)", MaxObjects);
+		object = SlotCount++;
+
+		Records.emplace_back();
+		TransformData.emplace_back();
+		IsDirty.push_back(0);
+	}
+
+	DrawObject& record = Records[object];
+	record.IndexCount = geometry.IndexCount;
+	record.FirstIndex = geometry.FirstIndex;
+	record.VertexOffset = geometry.VertexOffset;
+	record.Center[0] = center.x;
+	record.Center[1] = center.y;
+	record.Center[2] = center.z;
+	record.Radius = radius;
+
+	TransformData[object] = transform;
+	MarkDirty(object);
+
+	return object;
+}
+
+void VulkanDrawList::SetTransform(uint32_t object, const glm::mat4& transform)
+{
+	TransformData[object] = transform;
+	MarkDirty(object);
+}
+
+void VulkanDrawList::Remove(uint32_t object)
+{
+	Records[object] = DrawObject(); // Index count 0, never survives culling
+	MarkDirty(object);
+
+	FreeSlots.push_back(object);
+}
+
+void VulkanDrawList::MarkDirty(uint32_t object)
+{
+	if (!IsDirty[object])
+	{
+		IsDirty[object] = 1;
+		Dirty.push_back(object);
+	}
+}
+
+void VulkanDrawList::Build(const glm::mat4& viewProj)
+{
+	PROFILE_SCOPE("DrawList::Build");
+
+	VkCommandBuffer commandBuffer = Device->GetCommandBuffer();
+	Device->Profiler.BeginZone(commandBuffer, "Build Draws");
+
+	// Last frame's draws have to be done reading before anything is overwritten, same queue so an
+	// execution dependency covers it
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	if (!Cleared)
+	{
+		vkCmdFillBuffer(commandBuffer, Objects->Buffer, 0, VK_WHOLE_SIZE, 0);
+		Cleared = true;
+
+		// Transfers aren't ordered against each other, the copies land on top of the fill
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	CopyChanges(commandBuffer);
+
+	bool compact = Device->DrawIndirectCount;
+	if (compact)
+	{
+		vkCmdFillBuffer(commandBuffer, Count->Buffer, 0, sizeof(uint32_t), 0);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Occlusion projects into last frame's depth, so it needs last frame's camera too
+	CullData cull;
+	cull.PreviousViewProj = PreviousViewProj;
+	GetFrustumPlanes(viewProj, cull.Planes);
+	cull.Occlusion = Pyramid->Valid && HasPreviousViewProj ? 1 : 0;
+
+	PreviousViewProj = viewProj;
+	HasPreviousViewProj = true;
+
+	DrawSlots = SlotCount;
+	if (DrawSlots > 0)
+	{
+		// Bindings in the order the build shader declares them. Persistent, the pyramid clears those when its view changes.
+		DescriptorBinding bindings[] =
+		{
+			DescriptorBinding::MakeBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Objects->Buffer),
+			DescriptorBinding::MakeBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Commands->Buffer),
+			DescriptorBinding::MakeBuffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Count->Buffer),
+			DescriptorBinding::MakeBuffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, Transforms->Buffer),
+			DescriptorBinding::MakeImage(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, Pyramid->View, Pyramid->Sampler, VK_IMAGE_LAYOUT_GENERAL)
+		};
+
+		FrameAllocation cullData = Device->FrameAllocator.Push(cull);
+		VkDescriptorSet sets[] = { Device->Descriptors.GetPersistent(BuildPipeline->SetLayouts[0], bindings, 5), Device->FrameAllocator.UniformSet };
+
+		BuildPipeline->Bind(Device);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, BuildPipeline->PipelineLayout, 0, 2, sets, 1, &cullData.Offset);
+
+		BuildParams params = { DrawSlots, compact ? 1u : 0u };
+		vkCmdPushConstants(commandBuffer, BuildPipeline->PipelineLayout, VulkanLayoutCache::Stages, 0, sizeof(params), &params);
+
+		BuildPipeline->Dispatch(Device, (DrawSlots + GROUP_SIZE - 1) / GROUP_SIZE);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	Device->Profiler.EndZone(commandBuffer);
+}
+
+void VulkanDrawList::CopyChanges(VkCommandBuffer commandBuffer)
+{
+	if (Dirty.empty())
+		return;
+
+	// Ascending, so neighbouring objects merge into one copy region
+	std::sort(Dirty.begin(), Dirty.end());
+
+	const VkDeviceSize objectSize = sizeof(DrawObject) + sizeof(glm::mat4);
+	size_t count = std::min<size_t>(Dirty.size(), static_cast<size_t>(UPDATE_BUDGET / objectSize));
+
+	FrameAllocation records = Device->FrameAllocator.Allocate(sizeof(DrawObject) * count, FrameUsage::Vertex);
+	FrameAllocation transforms = Device->FrameAllocator.Allocate(sizeof(glm::mat4) * count, FrameUsage::Vertex);
+
+	std::vector<VkBufferCopy> recordCopies;
+	std::vector<VkBufferCopy> transformCopies;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t object = Dirty[i];
+		IsDirty[object] = 0;
+
+		memcpy(static_cast<uint8_t*>(records.Data) + sizeof(DrawObject) * i, &Records[object], sizeof(DrawObject));
+		memcpy(static_cast<uint8_t*>(transforms.Data) + sizeof(glm::mat4) * i, &TransformData[object], sizeof(glm::mat4));
+
+		if (i > 0 && object == Dirty[i - 1] + 1)
+		{
+			recordCopies.back().size += sizeof(DrawObject);
+			transformCopies.back().size += sizeof(glm::mat4);
+			continue;
+		}
+
+		VkBufferCopy copy;
+		copy.srcOffset = records.Offset + sizeof(DrawObject) * i;
+		copy.dstOffset = sizeof(DrawObject) * object;
+		copy.size = sizeof(DrawObject);
+		recordCopies.push_back(copy);
+
+		copy.srcOffset = transforms.Offset + sizeof(glm::mat4) * i;
+		copy.dstOffset = sizeof(glm::mat4) * object;
+		copy.size = sizeof(glm::mat4);
+		transformCopies.push_back(copy);
+	}
+
+	vkCmdCopyBuffer(commandBuffer, records.Buffer, Objects->Buffer, static_cast<uint32_t>(recordCopies.size()), recordCopies.data());
+	vkCmdCopyBuffer(commandBuffer, transforms.Buffer, Transforms->Buffer, static_cast<uint32_t>(transformCopies.size()), transformCopies.data());
+
+	Dirty.erase(Dirty.begin(), Dirty.begin() + count);
+}
+
+void VulkanDrawList::Draw()
+{
+	if (DrawSlots == 0)
+		return;
+
+	Device->BindVertexBuffer(VertexBuffer);
+	Device->BindIndexBuffer(IndexBuffer);
+	Device->BindInstanceBuffer(Transforms);
+
+	VkCommandBuffer commandBuffer = Device->GetCommandBuffer();
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	if (Device->DrawIndirectCount)
+	{
+		// Only the survivors, the GPU knows how many
+		Device->CmdDrawIndexedIndirectCount(commandBuffer, Commands->Buffer, 0, Count->Buffer, 0, DrawSlots, stride);
+	}
+	else if (Device->MultiDrawIndirect)
+	{
+		// Every slot, the empty ones have an instance count of 0
+		vkCmdDrawIndexedIndirect(commandBuffer, Commands->Buffer, 0, DrawSlots, stride);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < DrawSlots; i++)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, Commands->Buffer, stride * i, 1, stride);
+		}
+	}
+}
+
+void VulkanDrawList::GetFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6])
+{
+	// Gribb/Hartmann with Vulkan's 0..1 clip depth, glm is column major so rows are gathered by hand
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // Left
+	planes[1] = rows[3] - rows[0]; // Right
+	planes[2] = rows[3] + rows[1]; // Top (y points down)
+	planes[3] = rows[3] - rows[1]; // Bottom
+	planes[4] = rows[2]; // Near
+	planes[5] = rows[3] - rows[2]; // Far
+
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "glm/glm.hpp"
+
+#include "File.h"
+#include "VulkanGeometryPool.h"
+
+#include <vector>
+#include <cstdint>
+
+class VulkanBuffer;
+class VulkanComputePipeline;
+class VulkanDepthPyramid;
+
+// Persistent objects drawn with a single indirect call. A compute pass culls the objects against the
+// camera frustum and the previous frame's depth pyramid and compacts the survivors into
+// VkDrawIndexedIndirectCommands every frame, so the CPU cost no longer grows with the object count.
+// All objects share the geometry buffers of the first one (same vertex stride and index type), and each
+// reads its transform as a per instance mat4 from binding 1, picked through the command's firstInstance.
+class VulkanDrawList
+{
+public:
+	class VulkanDevice* Device;
+
+	// GPU layout of an object record, matches data/drawlist.comp
+	struct DrawObject
+	{
+		uint32_t IndexCount = 0; // 0 for free slots
+		uint32_t FirstIndex = 0;
+		int32_t VertexOffset = 0;
+		uint32_t Padding = 0;
+		float Center[3] = {}; // Bounding sphere, object space
+		float Radius = 0.0f;
+	};
+
+	// Occlusion tests are skipped while the pyramid has no depth to offer
+	static VulkanDrawList* Create(class VulkanDevice* device, const File::ByteView& buildShader, uint32_t maxObjects, VulkanDepthPyramid* pyramid);
+	static void Destroy(class VulkanDevice* device, VulkanDrawList* list);
+
+	// Main thread. Changes reach the GPU with the next Build.
+	uint32_t Add(const GeometryHandle& geometry, const glm::mat4& transform, const glm::vec3& center, float radius);
+	void SetTransform(uint32_t object, const glm::mat4& transform);
+	void Remove(uint32_t object);
+
+	// Copies this frame's changes, culls and builds the draw commands, between BeginFrame and BeginMainPass.
+	// The pyramid has to be built first.
+	void Build(const glm::mat4& viewProj);
+
+	// Inside the main pass, with a pipeline that reads the transform as an instance input. Any thread.
+	void Draw();
+
+	uint32_t GetObjectCount() const { return SlotCount - static_cast<uint32_t>(FreeSlots.size()); }
+
+protected:
+	// Frame allocator space used for changes per Build, the rest carries over to the next frames
+	const VkDeviceSize UPDATE_BUDGET = 2 * 1024 * 1024;
+	const uint32_t GROUP_SIZE = 64; // local_size_x of the build shader
+
+	struct BuildParams
+	{
+		uint32_t ObjectCount;
+		uint32_t Compact;
+	};
+
+	// std140, set 1 of the build shader through the frame allocator
+	struct CullData
+	{
+		glm::mat4 PreviousViewProj;
+		glm::vec4 Planes[6];
+		uint32_t Occlusion;
+	};
+
+	VulkanComputePipeline* BuildPipeline = nullptr;
+
+	VulkanBuffer* Objects = nullptr;
+	VulkanBuffer* Transforms = nullptr;
+	VulkanBuffer* Commands = nullptr;
+	VulkanBuffer* Count = nullptr;
+
+	VulkanDepthPyramid* Pyramid = nullptr;
+
+	glm::mat4 PreviousViewProj = glm::mat4(1.0f);
+	bool HasPreviousViewProj = false;
+
+	// Shared by every object
+	VulkanBuffer* VertexBuffer = nullptr;
+	VulkanBuffer* IndexBuffer = nullptr;
+
+	uint32_t MaxObjects = 0;
+	uint32_t SlotCount = 0; // High water mark, free slots below it are drawn as nothing
+	uint32_t DrawSlots = 0; // Slots the last Build wrote commands for
+	bool Cleared = false; // Objects buffer zeroed, so slots never written are empty
+
+	std::vector<DrawObject> Records;
+	std::vector<glm::mat4> TransformData;
+	std::vector<uint32_t> FreeSlots;
+
+	std::vector<uint32_t> Dirty;
+	std::vector<uint8_t> IsDirty;
+
+	VulkanDrawList() {}
+
+	void MarkDirty(uint32_t object);
+	void CopyChanges(VkCommandBuffer commandBuffer);
+
+	static void GetFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6]);
+};
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "VulkanFrameAllocator.h"
+
+#include "VulkanDevice.h"
+#include "Common.h"
+
+#include <algorithm>
+
+VulkanFrameAllocator::VulkanFrameAllocator()
+	: Head(0)
+{
+}
+
+void VulkanFrameAllocator::Create(VkDeviceSize frameSize)
+{
+	const VkPhysicalDeviceLimits& limits = Device->Properties.limits;
+
+	// Keep every region start aligned for any usage
+	VkDeviceSize alignment = std::max(GetAlignment(FrameUsage::Uniform), GetAlignment(FrameUsage::Storage));
+	FrameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+
+	// Storage buffers aren't bound by the uniform limit, their set can reach a whole frame region
+	UniformRange = std::min<VkDeviceSize>(65536, limits.maxUniformBufferRange);
+	StorageRange = std::min<VkDeviceSize>(FrameSize, limits.maxStorageBufferRange);
+
+	// Descriptors are written with a fixed range, pad the end so offset + range never leaves the buffer
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = FrameSize * Device->FramesAhead + std::max(UniformRange, StorageRange);
+	bufferInfo.usage =
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT; // Staging for updates copied on the graphics queue
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo allocationInfo = {};
+	allocationInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	allocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo info = {};
+	VkResult result = vmaCreateBuffer(Device->Allocator, &bufferInfo, &allocationInfo, &Buffer, &Allocation, &info);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create frame allocator buffer");
+
+	Mapped = static_cast<uint8_t*>(info.pMappedData);
+
+	VkMemoryPropertyFlags memoryFlags = 0;
+	vmaGetMemoryTypeProperties(Device->Allocator, info.memoryType, &memoryFlags);
+	Coherent = (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	CreateDescriptors();
+
+	LOG_VK("Frame allocator: %llu KB x %u frames", static_cast<unsigned long long>(FrameSize / 1024), Device->FramesAhead);
+}
+
+void VulkanFrameAllocator::Destroy()
+{
+	vkDestroyDescriptorPool(Device->Device, DescriptorPool, nullptr);
+
+	vmaDestroyBuffer(Device->Allocator, Buffer, Allocation);
+
+	Buffer = VK_NULL_HANDLE;
+	Allocation = nullptr;
+	Mapped = nullptr;
+}
+
+FrameAllocation VulkanFrameAllocator::Allocate(VkDeviceSize size, FrameUsage usage)
+{
+	VkDeviceSize alignment = GetAlignment(usage);
+
+	// Anything past the descriptor range would silently read as zero in the shader
+	CRITICAL_ASSERT(usage == FrameUsage::Vertex || size <= GetBindingRange(usage), "Frame allocation of %llu bytes exceeds the %llu byte binding range",
+		static_cast<unsigned long long>(size), static_cast<unsigned long long>(GetBindingRange(usage)));
+
+	// Lock free bump, recording threads can allocate concurrently
+	VkDeviceSize head = Head.load(std::memory_order_relaxed);
+	VkDeviceSize offset;
+	do
+	{
+		offset = (head + alignment - 1) & ~(alignment - 1);
+		CRITICAL_ASSERT(offset + size <= FrameStart + FrameSize, "Frame allocator out of memory (%llu bytes per frame)", static_cast<unsigned long long>(FrameSize));
+	} while (!Head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+	FrameAllocation allocation;
+	allocation.Data = Mapped + offset;
+	allocation.Buffer = Buffer;
+	allocation.Offset = static_cast<uint32_t>(offset);
+	allocation.Size = size;
+	allocation.Usage = usage;
+
+	return allocation;
+}
+
+void VulkanFrameAllocator::BeginFrame(uint32_t frame)
+{
+	// The frame's fence has been waited on, nothing reads this region anymore
+	FrameStart = FrameSize * frame;
+	Head.store(FrameStart, std::memory_order_relaxed);
+}
+
+void VulkanFrameAllocator::Flush()
+{
+	if (Coherent)
+		return;
+
+	VkDeviceSize used = Head.load(std::memory_order_relaxed) - FrameStart;
+	if (used > 0)
+	{
+		vmaFlushAllocation(Device->Allocator, Allocation, FrameStart, used);
+	}
+}
+
+VkDeviceSize VulkanFrameAllocator::GetAlignment(FrameUsage usage) const
+{
+	const VkPhysicalDeviceLimits& limits = Device->Properties.limits;
+
+	// Limits are powers of two, but make sure we never align to less than 16 bytes
+	switch (usage)
+	{
+	case FrameUsage::Uniform:
+		return std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+	case FrameUsage::Storage:
+		return std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 16);
+	case FrameUsage::Vertex:
+	default:
+		return 16;
+	}
+}
+
+VkDeviceSize VulkanFrameAllocator::GetBindingRange(FrameUsage usage) const
+{
+	switch (usage)
+	{
+	case FrameUsage::Uniform:
+		return UniformRange;
+	case FrameUsage::Storage:
+		return StorageRange;
+	case FrameUsage::Vertex:
+	default:
+		return FrameSize;
+	}
+}
+
+void VulkanFrameAllocator::CreateDescriptors()
+{
+	// Same layouts a reflected pipeline gets for a dynamic set with a single buffer at binding 0,
+	// so these sets bind straight into those pipelines
+	ShaderBinding binding;
+	binding.Binding = 0;
+
+	binding.Type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	UniformLayout = Device->Layouts.GetSetLayout({ binding });
+
+	binding.Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	StorageLayout = Device->Layouts.GetSetLayout({ binding });
+
+	VkDescriptorPoolSize poolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 2;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	VkResult result = vkCreateDescriptorPool(Device->Device, &poolInfo, nullptr, &DescriptorPool);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create descriptor pool");
+
+	VkDescriptorSetLayout layouts[] = { UniformLayout, StorageLayout };
+	VkDescriptorSet sets[2];
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = DescriptorPool;
+	allocateInfo.descriptorSetCount = 2;
+	allocateInfo.pSetLayouts = layouts;
+
+	result = vkAllocateDescriptorSets(Device->Device, &allocateInfo, sets);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate descriptor sets");
+
+	UniformSet = sets[0];
+	StorageSet = sets[1];
+
+	VkDescriptorBufferInfo bufferInfos[2] = {};
+	bufferInfos[0].buffer = Buffer;
+	bufferInfos[0].range = UniformRange;
+	bufferInfos[1].buffer = Buffer;
+	bufferInfos[1].range = StorageRange;
+
+	VkWriteDescriptorSet writes[2] = {};
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = sets[i];
+		writes[i].dstBinding = 0;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+	vkUpdateDescriptorSets(Device->Device, 2, writes, 0, nullptr);
+}
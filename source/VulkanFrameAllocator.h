@@ -0,0 +1,89 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+enum class FrameUsage
+{
+	Uniform,
+	Storage,
+	Vertex
+};
+
+// Transient per-frame data, only valid until the frame it was allocated in retires
+struct FrameAllocation
+{
+	void* Data = nullptr;
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	uint32_t Offset = 0; // Dynamic offset for the Uniform/Storage sets, or the vertex buffer offset
+	VkDeviceSize Size = 0;
+	FrameUsage Usage = FrameUsage::Uniform;
+};
+
+// One persistently mapped buffer split into a region per frame in flight.
+// Allocations bump a pointer inside the current frame's region, the region is reset wholesale
+// once the frame's fence has signaled, so the hot path never touches the driver or the heap.
+class VulkanFrameAllocator
+{
+public:
+	VulkanFrameAllocator();
+
+	class VulkanDevice* Device;
+
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	VmaAllocation Allocation = nullptr;
+
+	// Single dynamic binding (binding 0) sets over the whole buffer, bind with FrameAllocation::Offset.
+	// Layouts come from the device's layout cache.
+	VkDescriptorSetLayout UniformLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout StorageLayout = VK_NULL_HANDLE;
+	VkDescriptorSet UniformSet = VK_NULL_HANDLE;
+	VkDescriptorSet StorageSet = VK_NULL_HANDLE;
+
+	// Largest allocations that can be bound through the dynamic sets
+	VkDeviceSize UniformRange = 0;
+	VkDeviceSize StorageRange = 0;
+
+	void Create(VkDeviceSize frameSize);
+	void Destroy();
+
+	// Thread safe
+	FrameAllocation Allocate(VkDeviceSize size, FrameUsage usage);
+
+	template <typename T>
+	FrameAllocation Push(const T& value, FrameUsage usage = FrameUsage::Uniform)
+	{
+		FrameAllocation allocation = Allocate(sizeof(T), usage);
+		*static_cast<T*>(allocation.Data) = value;
+		return allocation;
+	}
+
+	template <typename T>
+	FrameAllocation PushArray(const T* values, size_t count, FrameUsage usage = FrameUsage::Vertex)
+	{
+		FrameAllocation allocation = Allocate(sizeof(T) * count, usage);
+		memcpy(allocation.Data, values, sizeof(T) * count);
+		return allocation;
+	}
+
+	void BeginFrame(uint32_t frame);
+	void Flush();
+
+protected:
+	uint8_t* Mapped = nullptr;
+	bool Coherent = true;
+
+	VkDeviceSize FrameSize = 0;
+	VkDeviceSize FrameStart = 0;
+	std::atomic<VkDeviceSize> Head;
+
+	VkDescriptorPool DescriptorPool = VK_NULL_HANDLE;
+
+	VkDeviceSize GetAlignment(FrameUsage usage) const;
+	VkDeviceSize GetBindingRange(FrameUsage usage) const;
+	void CreateDescriptors();
+};
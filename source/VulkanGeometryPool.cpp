@@ -0,0 +1,231 @@
+#include "VulkanGeometryPool.h"
+
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "Common.h"
+
+#include <algorithm>
+
+void VulkanGeometryPool::RangeAllocator::Reset(uint32_t capacity)
+{
+	FreeByOffset.clear();
+	FreeBySize.clear();
+	Capacity = capacity;
+	Used = 0;
+
+	Insert(0, capacity);
+}
+
+bool VulkanGeometryPool::RangeAllocator::Allocate(uint32_t count, uint32_t& offset)
+{
+	// Smallest free range that fits
+	auto fit = FreeBySize.lower_bound(count);
+	if (fit == FreeBySize.end())
+		return false;
+
+	offset = fit->second;
+	uint32_t available = fit->first;
+	Erase(FreeByOffset.find(offset));
+
+	if (available > count)
+	{
+		Insert(offset + count, available - count);
+	}
+
+	Used += count;
+	return true;
+}
+
+void VulkanGeometryPool::RangeAllocator::Release(uint32_t offset, uint32_t count)
+{
+	Used -= count;
+
+	auto next = FreeByOffset.find(offset + count);
+	if (next != FreeByOffset.end())
+	{
+		count += next->second;
+		Erase(next);
+	}
+
+	auto previous = FreeByOffset.lower_bound(offset);
+	if (previous != FreeByOffset.begin())
+	{
+		--previous;
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			count += previous->second;
+			Erase(previous);
+		}
+	}
+
+	Insert(offset, count);
+}
+
+void VulkanGeometryPool::RangeAllocator::Insert(uint32_t offset, uint32_t count)
+{
+	FreeByOffset.emplace(offset, count);
+	FreeBySize.emplace(count, offset);
+}
+
+void VulkanGeometryPool::RangeAllocator::Erase(std::map<uint32_t, uint32_t>::iterator range)
+{
+	auto sizes = FreeBySize.equal_range(range->second);
+	for (auto it = sizes.first; it != sizes.second; ++it)
+	{
+		if (it->second == range->first)
+		{
+			FreeBySize.erase(it);
+			break;
+		}
+	}
+	FreeByOffset.erase(range);
+}
+
+VulkanGeometryPool::VulkanGeometryPool()
+{
+}
+
+void VulkanGeometryPool::Create()
+{
+	// Blocks are made on first use, most strides never show up
+}
+
+void VulkanGeometryPool::Destroy()
+{
+	for (std::vector<Block*>* blocks : { &VertexBlocks, &IndexBlocks })
+	{
+		for (Block* block : *blocks)
+		{
+			vmaDestroyBuffer(Device->Allocator, block->Buffer->Buffer, block->Buffer->Allocation);
+			delete block->Buffer;
+			delete block;
+		}
+		blocks->clear();
+	}
+
+	PendingFrees.clear();
+}
+
+GeometryHandle VulkanGeometryPool::Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indices, uint32_t indexCount)
+{
+	VkIndexType indexType = VulkanBuffer::SelectIndexType(Device, vertexCount);
+	return Allocate(vertices, vertexCount, vertexStride, VulkanBuffer::PackIndices(indices, indexCount, vertexCount, indexType), indexCount, indexType);
+}
+
+GeometryHandle VulkanGeometryPool::Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint16_t* indices, uint32_t indexCount)
+{
+	VkIndexType indexType = VulkanBuffer::SelectIndexType(Device, vertexCount);
+	return Allocate(vertices, vertexCount, vertexStride, VulkanBuffer::PackIndices(indices, indexCount, vertexCount, indexType), indexCount, indexType);
+}
+
+GeometryHandle VulkanGeometryPool::Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const std::vector<uint8_t>& indices, uint32_t indexCount, VkIndexType indexType)
+{
+	CRITICAL_ASSERT(vertexCount > 0 && indexCount > 0, "Empty geometry");
+
+	GeometryHandle geometry;
+	geometry.VertexCount = vertexCount;
+	geometry.IndexCount = indexCount;
+
+	uint32_t vertexOffset;
+	uint32_t firstIndex;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		Block* vertexBlock = AllocateRange(VertexBlocks, false, vertexStride, VK_INDEX_TYPE_UINT16, vertexCount, vertexOffset);
+		Block* indexBlock = AllocateRange(IndexBlocks, true, VulkanBuffer::GetIndexSize(indexType), indexType, indexCount, firstIndex);
+
+		geometry.VertexBuffer = vertexBlock->Buffer;
+		geometry.IndexBuffer = indexBlock->Buffer;
+	}
+
+	geometry.VertexOffset = static_cast<int32_t>(vertexOffset);
+	geometry.FirstIndex = firstIndex;
+
+	// Uploader has its own lock
+	Device->Uploader.Upload(geometry.VertexBuffer, vertices, static_cast<VkDeviceSize>(vertexCount) * vertexStride, static_cast<VkDeviceSize>(vertexOffset) * vertexStride);
+	Device->Uploader.Upload(geometry.IndexBuffer, indices.data(), indices.size(), static_cast<VkDeviceSize>(firstIndex) * VulkanBuffer::GetIndexSize(indexType));
+
+	return geometry;
+}
+
+void VulkanGeometryPool::Free(const GeometryHandle& geometry)
+{
+	if (!geometry.IsValid())
+		return;
+
+	PendingFree pending;
+	pending.Geometry = geometry;
+	pending.Frame = Device->FrameCount;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	PendingFrees.push_back(pending);
+}
+
+void VulkanGeometryPool::BeginFrame()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	while (!PendingFrees.empty() && Device->IsFrameRetired(PendingFrees.front().Frame))
+	{
+		const GeometryHandle& geometry = PendingFrees.front().Geometry;
+		ReleaseRange(VertexBlocks, geometry.VertexBuffer, static_cast<uint32_t>(geometry.VertexOffset), geometry.VertexCount);
+		ReleaseRange(IndexBlocks, geometry.IndexBuffer, geometry.FirstIndex, geometry.IndexCount);
+		PendingFrees.pop_front();
+	}
+}
+
+VkDeviceSize VulkanGeometryPool::GetUsedBytes()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	VkDeviceSize used = 0;
+	for (std::vector<Block*>* blocks : { &VertexBlocks, &IndexBlocks })
+	{
+		for (Block* block : *blocks)
+		{
+			used += static_cast<VkDeviceSize>(block->Ranges.Used) * block->ElementSize;
+		}
+	}
+	return used;
+}
+
+VulkanGeometryPool::Block* VulkanGeometryPool::AllocateRange(std::vector<Block*>& blocks, bool index, uint32_t elementSize, VkIndexType indexType, uint32_t count, uint32_t& offset)
+{
+	for (Block* block : blocks)
+	{
+		bool compatible = block->ElementSize == elementSize && (!index || block->Buffer->IndexType == indexType);
+		if (compatible && block->Ranges.Allocate(count, offset))
+			return block;
+	}
+
+	// Offsets are counted in elements, so every block only ever holds one element size.
+	// Anything bigger than a block gets a block of its own.
+	uint32_t capacity = std::max(static_cast<uint32_t>(BLOCK_SIZE / elementSize), count);
+
+	Block* block = new Block();
+	block->ElementSize = elementSize;
+	block->Buffer = VulkanBuffer::Create(Device, index ? BufferType::Index : BufferType::Vertex, nullptr, static_cast<size_t>(capacity) * elementSize);
+	block->Buffer->IndexType = indexType;
+	block->Ranges.Reset(capacity);
+	blocks.push_back(block);
+
+	LOG_VK("Geometry pool: new %s block, %u x %u bytes", index ? "index" : "vertex", capacity, elementSize);
+
+	bool allocated = block->Ranges.Allocate(count, offset);
+	CRITICAL_ASSERT(allocated, "Fresh geometry block can't fit %u elements", count);
+	return block;
+}
+
+void VulkanGeometryPool::ReleaseRange(std::vector<Block*>& blocks, const VulkanBuffer* buffer, uint32_t offset, uint32_t count)
+{
+	for (Block* block : blocks)
+	{
+		if (block->Buffer == buffer)
+		{
+			block->Ranges.Release(offset, count);
+			return;
+		}
+	}
+	CRITICAL_ERROR("Freed geometry doesn't belong to the pool");
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+class VulkanBuffer;
+
+// One mesh's vertices and indices inside the shared geometry buffers. Every mesh with the same vertex stride
+// and index type lands in the same few buffers, so they bind once and each draw just passes its offsets.
+struct GeometryHandle
+{
+	VulkanBuffer* VertexBuffer = nullptr; // Bound at offset 0
+	VulkanBuffer* IndexBuffer = nullptr; // Bound at offset 0, carries the index type
+
+	int32_t VertexOffset = 0; // In vertices, for vkCmdDrawIndexed's vertexOffset
+	uint32_t FirstIndex = 0;
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+
+	bool IsValid() const { return VertexBuffer != nullptr; }
+};
+
+// Large device local buffers, one set per vertex stride and per index type, sub-allocated with a
+// best fit free list. Uploads go through the device's uploader.
+class VulkanGeometryPool
+{
+public:
+	VulkanGeometryPool();
+
+	class VulkanDevice* Device;
+
+	void Create();
+	void Destroy();
+
+	// Thread safe. Indices are stored as the smallest type that addresses vertexCount vertices.
+	GeometryHandle Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indices, uint32_t indexCount);
+	GeometryHandle Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint16_t* indices, uint32_t indexCount);
+
+	// Main thread, the ranges are handed out again once every frame that could still draw from them has retired
+	void Free(const GeometryHandle& geometry);
+
+	// After the frame's fence was waited on
+	void BeginFrame();
+
+	VkDeviceSize GetUsedBytes();
+
+protected:
+	// Best fit over [0, capacity) in elements, neighbouring free ranges merge on release
+	class RangeAllocator
+	{
+	public:
+		void Reset(uint32_t capacity);
+		bool Allocate(uint32_t count, uint32_t& offset);
+		void Release(uint32_t offset, uint32_t count);
+
+		uint32_t Capacity = 0;
+		uint32_t Used = 0;
+
+	private:
+		std::map<uint32_t, uint32_t> FreeByOffset; // offset -> count
+		std::multimap<uint32_t, uint32_t> FreeBySize; // count -> offset
+
+		void Insert(uint32_t offset, uint32_t count);
+		void Erase(std::map<uint32_t, uint32_t>::iterator range);
+	};
+
+	struct Block
+	{
+		VulkanBuffer* Buffer = nullptr;
+		uint32_t ElementSize = 0; // Vertex stride or index size
+		RangeAllocator Ranges;
+	};
+
+	struct PendingFree
+	{
+		GeometryHandle Geometry;
+		uint64_t Frame = 0;
+	};
+
+	const VkDeviceSize BLOCK_SIZE = 32 * 1024 * 1024;
+
+	std::vector<Block*> VertexBlocks;
+	std::vector<Block*> IndexBlocks;
+	std::deque<PendingFree> PendingFrees;
+
+	std::mutex Mutex;
+
+	GeometryHandle Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const std::vector<uint8_t>& indices, uint32_t indexCount, VkIndexType indexType);
+
+	// Requires Mutex
+	Block* AllocateRange(std::vector<Block*>& blocks, bool index, uint32_t elementSize, VkIndexType indexType, uint32_t count, uint32_t& offset);
+	void ReleaseRange(std::vector<Block*>& blocks, const VulkanBuffer* buffer, uint32_t offset, uint32_t count);
+};
\ No newline at end of file
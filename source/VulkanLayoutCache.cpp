@@ -0,0 +1,176 @@
+#include "VulkanLayoutCache.h"
+
+#include "VulkanDevice.h"
+#include "Common.h"
+
+#include <algorithm>
+
+VulkanLayoutCache::VulkanLayoutCache()
+{
+}
+
+void VulkanLayoutCache::Destroy()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	for (auto& entry : PipelineLayouts)
+	{
+		vkDestroyPipelineLayout(Device->Device, entry.second, nullptr);
+	}
+	for (auto& entry : SetLayouts)
+	{
+		vkDestroyDescriptorSetLayout(Device->Device, entry.second, nullptr);
+	}
+
+	PipelineLayouts.clear();
+	SetLayouts.clear();
+}
+
+VkDescriptorSetLayout VulkanLayoutCache::GetSetLayout(const std::vector<ShaderBinding>& bindings)
+{
+	std::vector<ShaderBinding> sorted = bindings;
+	std::sort(sorted.begin(), sorted.end(), [](const ShaderBinding& a, const ShaderBinding& b) { return a.Binding < b.Binding; });
+
+	Key key;
+	for (const ShaderBinding& binding : sorted)
+	{
+		key.push_back(binding.Binding);
+		key.push_back(binding.Type);
+		key.push_back(binding.Count);
+	}
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	auto it = SetLayouts.find(key);
+	if (it != SetLayouts.end())
+		return it->second;
+
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings(sorted.size());
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		CRITICAL_ASSERT(sorted[i].Count != 0, "Runtime sized descriptor arrays only work in the bindless set (set %u, binding %u)", sorted[i].Set, sorted[i].Binding);
+
+		layoutBindings[i].binding = sorted[i].Binding;
+		layoutBindings[i].descriptorType = sorted[i].Type;
+		layoutBindings[i].descriptorCount = sorted[i].Count;
+		layoutBindings[i].stageFlags = Stages;
+	}
+
+	VkDescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	createInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	createInfo.pBindings = layoutBindings.data();
+
+	VkDescriptorSetLayout layout;
+	VkResult result = vkCreateDescriptorSetLayout(Device->Device, &createInfo, nullptr, &layout);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create descriptor set layout");
+
+	SetLayouts[key] = layout;
+	return layout;
+}
+
+VkPipelineLayout VulkanLayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, uint32_t pushConstantSize)
+{
+	Key key;
+	for (VkDescriptorSetLayout layout : setLayouts)
+	{
+		key.push_back(reinterpret_cast<uint64_t>(layout));
+	}
+	key.push_back(pushConstantSize);
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	auto it = PipelineLayouts.find(key);
+	if (it != PipelineLayouts.end())
+		return it->second;
+
+	// One range over everything, push constants are pushed with Stages
+	VkPushConstantRange range = {};
+	range.stageFlags = Stages;
+	range.offset = 0;
+	range.size = pushConstantSize;
+
+	VkPipelineLayoutCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	createInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	createInfo.pSetLayouts = setLayouts.data();
+	createInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+	createInfo.pPushConstantRanges = &range;
+
+	VkPipelineLayout layout;
+	VkResult result = vkCreatePipelineLayout(Device->Device, &createInfo, nullptr, &layout);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Pipeline layout creation failed");
+
+	PipelineLayouts[key] = layout;
+	return layout;
+}
+
+VkPipelineLayout VulkanLayoutCache::GetPipelineLayout(const std::vector<const ShaderReflection*>& stages, uint32_t dynamicSets, std::vector<VkDescriptorSetLayout>& setLayouts)
+{
+	std::vector<std::vector<ShaderBinding>> sets;
+	uint32_t pushConstantSize = 0;
+
+	for (const ShaderReflection* stage : stages)
+	{
+		pushConstantSize = std::max(pushConstantSize, stage->PushConstantSize);
+
+		for (ShaderBinding binding : stage->Bindings)
+		{
+			if (dynamicSets & (1u << binding.Set))
+			{
+				if (binding.Type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+					binding.Type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+				else if (binding.Type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+					binding.Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+			}
+
+			if (binding.Set >= sets.size())
+			{
+				sets.resize(binding.Set + 1);
+			}
+
+			// Same binding seen from another stage
+			std::vector<ShaderBinding>& set = sets[binding.Set];
+			auto existing = std::find_if(set.begin(), set.end(), [&](const ShaderBinding& other) { return other.Binding == binding.Binding; });
+			if (existing != set.end())
+			{
+				CRITICAL_ASSERT(existing->Type == binding.Type, "Stages disagree on the type of set %u, binding %u", binding.Set, binding.Binding);
+				existing->Count = std::max(existing->Count, binding.Count);
+			}
+			else
+			{
+				set.push_back(binding);
+			}
+		}
+	}
+
+	// Unused sets in between still need a (empty) layout
+	setLayouts.resize(sets.size());
+	for (size_t i = 0; i < sets.size(); i++)
+	{
+		if (i == VulkanBindless::SET && !sets[i].empty())
+		{
+			setLayouts[i] = GetBindlessLayout(sets[i]);
+			continue;
+		}
+
+		setLayouts[i] = GetSetLayout(sets[i]);
+	}
+
+	return GetPipelineLayout(setLayouts, pushConstantSize);
+}
+
+VkDescriptorSetLayout VulkanLayoutCache::GetBindlessLayout(const std::vector<ShaderBinding>& bindings)
+{
+	CRITICAL_ASSERT(Device->Bindless.IsAvailable(), "Shader uses the bindless set %u, but descriptor indexing is not available", VulkanBindless::SET);
+
+	// Shaders declare any subset of the arrays, the set itself always has all of them
+	const VkDescriptorType types[] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER };
+	for (const ShaderBinding& binding : bindings)
+	{
+		CRITICAL_ASSERT(binding.Binding < static_cast<uint32_t>(BindlessType::Count) && binding.Type == types[binding.Binding],
+			"Binding %u doesn't match the bindless set's layout", binding.Binding);
+	}
+
+	return Device->Bindless.Layout;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include "SpirvReflection.h"
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+// Descriptor set and pipeline layouts keyed by their contents, so pipelines with matching
+// resources share the very same handles (and stay compatible for set binding across pipelines).
+// Layouts live until Destroy, callers never destroy them themselves.
+class VulkanLayoutCache
+{
+public:
+	VulkanLayoutCache();
+
+	class VulkanDevice* Device;
+
+	// Bindings and push constants are visible to every stage, shaders that only differ in which
+	// stage reads a resource still end up with the same layout
+	static const VkShaderStageFlags Stages = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	void Destroy();
+
+	// Thread safe
+	VkDescriptorSetLayout GetSetLayout(const std::vector<ShaderBinding>& bindings);
+	VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, uint32_t pushConstantSize);
+
+	// Merges the stages' bindings into one layout, buffers in sets flagged in dynamicSets (bit per set)
+	// become dynamic so they can be bound with per-draw offsets, like the frame allocator's sets.
+	// VulkanBindless::SET always gets the global bindless layout.
+	VkPipelineLayout GetPipelineLayout(const std::vector<const ShaderReflection*>& stages, uint32_t dynamicSets, std::vector<VkDescriptorSetLayout>& setLayouts);
+
+protected:
+	typedef std::vector<uint64_t> Key;
+
+	std::map<Key, VkDescriptorSetLayout> SetLayouts;
+	std::map<Key, VkPipelineLayout> PipelineLayouts;
+
+	std::mutex Mutex;
+
+	// VulkanBindless::SET, owned by the device's bindless set rather than the cache
+	VkDescriptorSetLayout GetBindlessLayout(const std::vector<ShaderBinding>& bindings);
+};
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "VulkanMesh.h"
+
+#include "MeshFormat.h"
+#include "VulkanDevice.h"
+#include "Common.h"
+
+#include <cstring>
+
+VulkanMesh* VulkanMesh::Create(VulkanDevice* device, File::ByteView bytes)
+{
+	MeshFormat::Header header;
+	CRITICAL_ASSERT(bytes.Size >= sizeof(header), "Mesh is too small for its header");
+	memcpy(&header, bytes.Data, sizeof(header));
+
+	CRITICAL_ASSERT(header.Magic == MeshFormat::Magic, "Not a mesh file");
+	CRITICAL_ASSERT(header.Version == MeshFormat::Version, "Mesh version %u, expected %u", header.Version, MeshFormat::Version);
+	CRITICAL_ASSERT(header.IndexSize == 2 || header.IndexSize == 4, "Invalid mesh index size %u", header.IndexSize);
+
+	uint64_t verticesSize = static_cast<uint64_t>(header.VertexCount) * header.VertexStride;
+	uint64_t indicesSize = static_cast<uint64_t>(header.IndexCount) * header.IndexSize;
+	CRITICAL_ASSERT(header.VerticesOffset + verticesSize <= bytes.Size && header.IndicesOffset + indicesSize <= bytes.Size, "Mesh data out of bounds");
+	CRITICAL_ASSERT(header.VertexCount > 0 && header.IndexCount > 0 && header.IndexCount % 3 == 0, "Mesh has no triangles");
+
+	VulkanMesh* mesh = new VulkanMesh();
+	mesh->VertexCount = header.VertexCount;
+	mesh->VertexStride = header.VertexStride;
+	mesh->IndexCount = header.IndexCount;
+
+	mesh->BoundsMin = glm::vec3(header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2]);
+	mesh->BoundsMax = glm::vec3(header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2]);
+	mesh->Center = glm::vec3(header.Center[0], header.Center[1], header.Center[2]);
+	mesh->Radius = header.Radius;
+
+	const uint8_t* vertices = bytes.Data + header.VerticesOffset;
+	const uint8_t* indices = bytes.Data + header.IndicesOffset;
+	if (header.IndexSize == 2)
+	{
+		mesh->Geometry = device->Geometry.Allocate(vertices, header.VertexCount, header.VertexStride, reinterpret_cast<const uint16_t*>(indices), header.IndexCount);
+	}
+	else
+	{
+		mesh->Geometry = device->Geometry.Allocate(vertices, header.VertexCount, header.VertexStride, reinterpret_cast<const uint32_t*>(indices), header.IndexCount);
+	}
+
+	return mesh;
+}
+
+VulkanMesh* VulkanMesh::CreateFromFile(VulkanDevice* device, const std::string& fileName)
+{
+	// The uploader copies into staging, the mapping can go right after
+	File::MappedFile file = File::Map(fileName);
+	return Create(device, file.View());
+}
+
+void VulkanMesh::Destroy(VulkanDevice* device, VulkanMesh* mesh)
+{
+	device->Geometry.Free(mesh->Geometry);
+	delete mesh;
+}
\ No newline at end of file
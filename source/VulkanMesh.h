@@ -0,0 +1,37 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "glm/glm.hpp"
+
+#include "File.h"
+#include "VulkanGeometryPool.h"
+
+#include <string>
+#include <cstdint>
+
+// Cooked mesh (see MeshFormat.h) in the device's geometry pool
+class VulkanMesh
+{
+public:
+	GeometryHandle Geometry; // Indices may be narrower than the cooked ones
+
+	uint32_t VertexCount = 0;
+	uint32_t VertexStride = 0;
+	uint32_t IndexCount = 0;
+
+	glm::vec3 BoundsMin = glm::vec3(0.0f);
+	glm::vec3 BoundsMax = glm::vec3(0.0f);
+	glm::vec3 Center = glm::vec3(0.0f);
+	float Radius = 0.0f;
+
+	// Vertices go to the uploader as they are, bytes only have to live until this returns
+	static VulkanMesh* Create(class VulkanDevice* device, File::ByteView bytes);
+
+	static VulkanMesh* CreateFromFile(class VulkanDevice* device, const std::string& fileName);
+
+	// Returns the geometry to the pool once the GPU is done with it, main thread
+	static void Destroy(class VulkanDevice* device, VulkanMesh* mesh);
+
+protected:
+	VulkanMesh() {}
+};
\ No newline at end of file
@@ -3,12 +3,74 @@
 #include "Common.h"
 #include "VulkanDevice.h"
 
-VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader* const shader, std::vector<VertexAttribute> attributes, uint32_t vertexSize)
+#include <functional>
+#include <algorithm>
+
+bool PipelineDescription::operator==(const PipelineDescription& other) const
+{
+	return
+		Shader == other.Shader &&
+		DynamicSets == other.DynamicSets &&
+		std::equal(VertexFormats, VertexFormats + MAX_VERTEX_INPUTS, other.VertexFormats) &&
+		InstanceInputs == other.InstanceInputs &&
+		Topology == other.Topology &&
+		PolygonMode == other.PolygonMode &&
+		CullMode == other.CullMode &&
+		FrontFace == other.FrontFace &&
+		DepthTest == other.DepthTest &&
+		DepthWrite == other.DepthWrite &&
+		DepthCompare == other.DepthCompare &&
+		Blend == other.Blend &&
+		RenderPass == other.RenderPass &&
+		Subpass == other.Subpass;
+}
+
+size_t PipelineDescription::Hash() const
+{
+	size_t hash = std::hash<const void*>()(Shader);
+	auto combine = [&hash](uint64_t value)
+	{
+		hash ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	};
+
+	combine(DynamicSets);
+	for (AttributeType format : VertexFormats)
+	{
+		combine(static_cast<uint64_t>(format));
+	}
+	combine(InstanceInputs);
+	combine(Topology);
+	combine(PolygonMode);
+	combine(CullMode);
+	combine(FrontFace);
+	combine((DepthTest ? 1 : 0) | (DepthWrite ? 2 : 0) | (Blend ? 4 : 0));
+	combine(DepthCompare);
+	combine(reinterpret_cast<uint64_t>(RenderPass));
+	combine(Subpass);
+
+	return hash;
+}
+
+VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader* const shader, uint32_t dynamicSets)
+{
+	PipelineDescription description;
+	description.Shader = shader;
+	description.DynamicSets = dynamicSets;
+
+	return Create(device, description);
+}
+
+VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const PipelineDescription& description)
+{
+	return device->Pipelines.Get(description);
+}
+
+VulkanPipeline* VulkanPipeline::Compile(VulkanDevice* device, const PipelineDescription& description, VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule)
 {
 	VulkanPipeline* pipeline = new VulkanPipeline();
+	pipeline->Description = description;
 
-	VkShaderModule vertexShaderModule = CreateShader(device->Device, shader->VertexBytes);
-	VkShaderModule fragmentShaderModule = CreateShader(device->Device, shader->FragmentBytes);
+	const VulkanShader* shader = description.Shader;
 
 	VkPipelineShaderStageCreateInfo vertexShaderStage = {};
 	vertexShaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -24,75 +86,85 @@ VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader*
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStage, fragmentShaderStage };
 
-	// vertex binding
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = vertexSize;
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	// vertex attribs, packed in location order per binding
+	const std::vector<ShaderInput>& inputs = shader->VertexReflection.Inputs;
 
-	// vertex attribs
-	std::vector<VkVertexInputAttributeDescription> attribs(attributes.size());
-	for (size_t i = 0; i < attributes.size(); i++)
+	std::vector<VkVertexInputAttributeDescription> attribs(inputs.size());
+	for (size_t i = 0; i < inputs.size(); i++)
 	{
-		VertexAttribute& attribute = attributes[i];
+		uint32_t location = inputs[i].Location;
+		AttributeType type = location < PipelineDescription::MAX_VERTEX_INPUTS ? description.VertexFormats[location] : AttributeType::Default;
+
+		bool perInstance = location < 32 && (description.InstanceInputs & (1u << location)) != 0;
+		uint32_t& stride = perInstance ? pipeline->InstanceStride : pipeline->VertexStride;
+
+		attribs[i].binding = perInstance ? 1 : 0;
+		attribs[i].location = location;
+		attribs[i].offset = stride;
 
-		VkFormat format;
-		switch (attribute.Type)
+		if (type == AttributeType::Default)
 		{
-		case AttributeType::Float2: format = VK_FORMAT_R32G32_SFLOAT; break;
-		case AttributeType::Float3: format = VK_FORMAT_R32G32B32_SFLOAT; break;
+			attribs[i].format = inputs[i].Format;
+			stride += inputs[i].Size;
 		}
+		else
+		{
+			// Packed formats are all in the mandatory vertex format set except A2B10G10R10_SNORM, check anyway
+			attribs[i].format = GetAttributeFormat(type);
+			stride += VertexFormat::GetSize(type);
 
-		attribs[i].binding = 0;
-		attribs[i].location = static_cast<uint32_t>(i);
-		attribs[i].format = format;
-		attribs[i].offset = attribute.Offset;
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(device->PhysicalDevice, attribs[i].format, &properties);
+			CRITICAL_ASSERT(properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT, "Vertex format %u for location %u isn't supported", static_cast<uint32_t>(type), location);
+		}
+	}
+
+	// vertex bindings, only the ones something reads from
+	VkVertexInputBindingDescription bindingDescriptions[2] = {};
+	uint32_t bindingCount = 0;
+	if (pipeline->VertexStride > 0)
+	{
+		bindingDescriptions[bindingCount].binding = 0;
+		bindingDescriptions[bindingCount].stride = pipeline->VertexStride;
+		bindingDescriptions[bindingCount].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingCount++;
+	}
+	if (pipeline->InstanceStride > 0)
+	{
+		bindingDescriptions[bindingCount].binding = 1;
+		bindingDescriptions[bindingCount].stride = pipeline->InstanceStride;
+		bindingDescriptions[bindingCount].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		bindingCount++;
 	}
 
 	VkPipelineVertexInputStateCreateInfo vertexInput = {};
 	vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInput.vertexBindingDescriptionCount = 1;
-	vertexInput.pVertexBindingDescriptions = &bindingDescription;
+	vertexInput.vertexBindingDescriptionCount = bindingCount;
+	vertexInput.pVertexBindingDescriptions = bindingDescriptions;
 	vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribs.size());
 	vertexInput.pVertexAttributeDescriptions = attribs.data();
 
 	//
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.topology = description.Topology;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	//
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(device->Swapchain.Extent.width); // TODO:
-	viewport.height = static_cast<float>(device->Swapchain.Extent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	//
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = device->Swapchain.Extent; // TODO:
-
-	//
+	// Viewport and scissor are dynamic (set per frame by the device), so pipelines survive swapchain resizes
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
 
 	//
 	VkPipelineRasterizationStateCreateInfo rasterizer = {};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rasterizer.depthClampEnable = VK_FALSE;
 	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.polygonMode = description.PolygonMode;
 	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer.cullMode = description.CullMode;
+	rasterizer.frontFace = description.FrontFace;
 	rasterizer.depthBiasEnable = VK_FALSE;
 
 	//
@@ -102,7 +174,11 @@ VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader*
 	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
 	//
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {}; // using nullptr til we need depthtesting
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = description.DepthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = description.DepthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = description.DepthCompare;
 
 	//
 	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
@@ -111,7 +187,13 @@ VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader*
 		VK_COLOR_COMPONENT_G_BIT |
 		VK_COLOR_COMPONENT_B_BIT |
 		VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE; // no blending !
+	colorBlendAttachment.blendEnable = description.Blend ? VK_TRUE : VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
 	//
 	VkPipelineColorBlendStateCreateInfo colorBlending = {};
@@ -124,19 +206,18 @@ VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader*
 	VkDynamicState dynamicStates[] =
 	{
 		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
 	};
 
-	VkPipelineDynamicStateCreateInfo dynamicState = {}; // UNUSED !!!!!!!!!!!!!!!!
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
 	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = 1;
+	dynamicState.dynamicStateCount = 2;
 	dynamicState.pDynamicStates = dynamicStates;
 
-	//
-	VkPipelineLayoutCreateInfo pipelineLayout = {};
-	pipelineLayout.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-
-	VkResult result = vkCreatePipelineLayout(device->Device, &pipelineLayout, nullptr, &pipeline->PipelineLayout);
-	CRITICAL_ASSERT(result == VK_SUCCESS, "Pipeline layout creation failed");
+	// Layout from what the shaders actually declare
+	std::vector<const ShaderReflection*> reflections = { &shader->VertexReflection, &shader->FragmentReflection };
+	pipeline->PipelineLayout = device->Layouts.GetPipelineLayout(reflections, description.DynamicSets, pipeline->SetLayouts);
+	pipeline->UsesBindless = pipeline->SetLayouts.size() > VulkanBindless::SET && pipeline->SetLayouts[VulkanBindless::SET] == device->Bindless.Layout;
 
 	// Create
 	VkGraphicsPipelineCreateInfo createInfo = {};
@@ -148,38 +229,32 @@ VulkanPipeline* VulkanPipeline::Create(VulkanDevice* device, const VulkanShader*
 	createInfo.pViewportState = &viewportState;
 	createInfo.pRasterizationState = &rasterizer;
 	createInfo.pMultisampleState = &multisampling;
-	createInfo.pDepthStencilState = nullptr; // !!!!!!!!
+	createInfo.pDepthStencilState = &depthStencil; // Ignored by passes without a depth attachment
 	createInfo.pColorBlendState = &colorBlending;
-	createInfo.pDynamicState = nullptr;
+	createInfo.pDynamicState = &dynamicState;
 	createInfo.layout = pipeline->PipelineLayout;
-	createInfo.renderPass = device->Swapchain.RenderPass;
-	createInfo.subpass = 0;
+	createInfo.renderPass = description.RenderPass != VK_NULL_HANDLE ? description.RenderPass : device->Swapchain.RenderPass;
+	createInfo.subpass = description.Subpass;
 
-	result = vkCreateGraphicsPipelines(device->Device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline->Pipeline);
+	VkResult result = vkCreateGraphicsPipelines(device->Device, device->PipelineCache, 1, &createInfo, nullptr, &pipeline->Pipeline);
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Graphics pipeline creation failed");
 
-	//
-	vkDestroyShaderModule(device->Device, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(device->Device, vertexShaderModule, nullptr);
-
 	return pipeline;
 }
 
-VkShaderModule VulkanPipeline::CreateShader(VkDevice device, std::vector<uint8_t> bytes)
+VkShaderModule VulkanPipeline::CreateShader(VkDevice device, const File::ByteView& bytes)
 {
+	// Mappings are page aligned, anything else handed in has to be at least 4 byte aligned for pCode
+	CRITICAL_ASSERT(bytes.Size % 4 == 0 && reinterpret_cast<uintptr_t>(bytes.Data) % 4 == 0, "SPIR-V code is misaligned or truncated");
+
 	VkShaderModuleCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = bytes.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(bytes.data());
+	createInfo.codeSize = bytes.Size;
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(bytes.Data);
 
 	VkShaderModule shaderModule;
 	VkResult result = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule);
-
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Shader module creation failed");
 
 	return shaderModule;
-}
-
-//void VulkanPipeline::SetShader(const VulkanShader* const shader)
-//{
-//
-//}
\ No newline at end of file
+}
\ No newline at end of file
@@ -5,18 +5,72 @@
 #include "VulkanShader.h"
 #include "VulkanBuffer.h"
 
+#include <cstddef>
+
+// Everything a graphics pipeline is built from, identical descriptions share one VulkanPipeline
+struct PipelineDescription
+{
+	static const uint32_t MAX_VERTEX_INPUTS = 8;
+
+	const VulkanShader* Shader = nullptr;
+	uint32_t DynamicSets = 0; // Bit per set, buffers in these sets are bound with dynamic offsets
+
+	// Per input location, how the vertex buffer stores it. Default fetches the shader's own type at full precision.
+	AttributeType VertexFormats[MAX_VERTEX_INPUTS] = {};
+
+	// Bit per input location, these advance per instance and are read from binding 1 instead of binding 0
+	uint32_t InstanceInputs = 0;
+
+	VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode PolygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace FrontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	bool DepthTest = false;
+	bool DepthWrite = false;
+	VkCompareOp DepthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	bool Blend = false; // Straight alpha blending
+
+	VkRenderPass RenderPass = VK_NULL_HANDLE; // Any compatible pass, null for the swapchain's
+	uint32_t Subpass = 0;
+
+	bool operator==(const PipelineDescription& other) const;
+	size_t Hash() const;
+};
+
+struct PipelineDescriptionHash
+{
+	size_t operator()(const PipelineDescription& description) const { return description.Hash(); }
+};
+
 class VulkanPipeline
 {
 public:
 	VkPipeline Pipeline;
-	VkPipelineLayout PipelineLayout;
+	VkPipelineLayout PipelineLayout; // Shared through the device's layout cache, not owned
 
-	static VulkanPipeline* Create(class VulkanDevice* device, const VulkanShader* const shader, std::vector<VertexAttribute> attributes, uint32_t vertexSize);
+	std::vector<VkDescriptorSetLayout> SetLayouts;
+	bool UsesBindless = false; // Has the device's bindless set at VulkanBindless::SET
 
-	// void SetShader(const VulkanShader* const shader);
+	// Vertex inputs are read tightly packed from binding 0, instance inputs from binding 1, both in location order
+	uint32_t VertexStride = 0;
+	uint32_t InstanceStride = 0;
 
-	// void Compile();
+	PipelineDescription Description;
+
+	// Vertex input and layouts come from the shader's reflection, buffers in dynamicSets (bit per set) are bound with dynamic offsets
+	static VulkanPipeline* Create(class VulkanDevice* device, const VulkanShader* const shader, uint32_t dynamicSets = 0);
+
+	// Returns the device's existing pipeline for an identical description, pipelines are owned by the device
+	static VulkanPipeline* Create(class VulkanDevice* device, const PipelineDescription& description);
 
 protected:
-	static VkShaderModule CreateShader(VkDevice device, std::vector<uint8_t> bytes);
+	friend class VulkanPipelineCache;
+	friend class VulkanComputePipeline;
+
+	// Always builds a new VkPipeline, only the cache calls this
+	static VulkanPipeline* Compile(class VulkanDevice* device, const PipelineDescription& description, VkShaderModule vertexModule, VkShaderModule fragmentModule);
+
+	static VkShaderModule CreateShader(VkDevice device, const File::ByteView& bytes);
 };
\ No newline at end of file
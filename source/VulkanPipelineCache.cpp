@@ -0,0 +1,198 @@
+#include "VulkanPipelineCache.h"
+
+#include "VulkanDevice.h"
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+#include "Common.h"
+
+VulkanPipelineCache::VulkanPipelineCache()
+	: Hits(0), Misses(0)
+{
+}
+
+void VulkanPipelineCache::Destroy()
+{
+	// Jobs still in the queue reference entries
+	WaitAll();
+
+	for (Shard& shard : Shards)
+	{
+		std::lock_guard<std::mutex> lock(shard.Mutex);
+		for (auto& entry : shard.Pipelines)
+		{
+			VulkanPipeline* pipeline = entry.second->Pipeline.load();
+			if (pipeline != nullptr)
+			{
+				vkDestroyPipeline(Device->Device, pipeline->Pipeline, nullptr);
+				delete pipeline;
+			}
+			delete entry.second;
+		}
+		shard.Pipelines.clear();
+	}
+
+	std::lock_guard<std::mutex> lock(ModulesMutex);
+	for (auto& entry : Modules)
+	{
+		vkDestroyShaderModule(Device->Device, entry.second.Vertex, nullptr);
+		vkDestroyShaderModule(Device->Device, entry.second.Fragment, nullptr);
+	}
+	Modules.clear();
+}
+
+VulkanPipeline* VulkanPipelineCache::Get(const PipelineDescription& description)
+{
+	Shard& shard = GetShard(description);
+
+	bool created;
+	PipelineEntry* entry = FindOrInsert(shard, description, created);
+
+	VulkanPipeline* pipeline = entry->Pipeline.load(std::memory_order_acquire);
+	if (pipeline != nullptr)
+		return pipeline;
+
+	// Still queued on the pool, no point waiting for a worker to get to it
+	if (!entry->Claimed.exchange(true))
+	{
+		Compile(shard, entry, description);
+		return entry->Pipeline.load();
+	}
+
+	std::unique_lock<std::mutex> lock(shard.Mutex);
+	shard.Compiled.wait(lock, [entry]() { return entry->Pipeline.load() != nullptr; });
+
+	return entry->Pipeline.load();
+}
+
+PipelineHandle VulkanPipelineCache::GetAsync(const PipelineDescription& description, PipelineCallback onReady)
+{
+	Shard& shard = GetShard(description);
+
+	bool created;
+	PipelineEntry* entry = FindOrInsert(shard, description, created);
+
+	if (onReady)
+	{
+		std::unique_lock<std::mutex> lock(shard.Mutex);
+
+		VulkanPipeline* pipeline = entry->Pipeline.load();
+		if (pipeline != nullptr)
+		{
+			lock.unlock();
+			onReady(pipeline);
+		}
+		else
+		{
+			entry->Callbacks.push_back(std::move(onReady));
+		}
+	}
+
+	if (created)
+	{
+		if (Workers == nullptr)
+		{
+			entry->Claimed = true;
+			Compile(shard, entry, description);
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(PendingMutex);
+				Pending++;
+			}
+
+			// Description by value, the caller's copy is long gone when this runs
+			Workers->Submit([this, &shard, entry, description]()
+			{
+				if (!entry->Claimed.exchange(true))
+				{
+					Compile(shard, entry, description);
+				}
+
+				std::lock_guard<std::mutex> lock(PendingMutex);
+				if (--Pending == 0)
+				{
+					PendingDone.notify_all();
+				}
+			});
+		}
+	}
+
+	return PipelineHandle(entry);
+}
+
+void VulkanPipelineCache::WaitAll()
+{
+	std::unique_lock<std::mutex> lock(PendingMutex);
+	PendingDone.wait(lock, [this]() { return Pending == 0; });
+}
+
+uint32_t VulkanPipelineCache::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(PendingMutex);
+	return Pending;
+}
+
+VulkanPipelineCache::Shard& VulkanPipelineCache::GetShard(const PipelineDescription& description)
+{
+	CRITICAL_ASSERT(description.Shader != nullptr, "Pipeline description without a shader");
+
+	// Low bits pick the map bucket
+	return Shards[(description.Hash() >> 8) % SHARD_COUNT];
+}
+
+PipelineEntry* VulkanPipelineCache::FindOrInsert(Shard& shard, const PipelineDescription& description, bool& created)
+{
+	std::lock_guard<std::mutex> lock(shard.Mutex);
+
+	auto it = shard.Pipelines.find(description);
+	if (it != shard.Pipelines.end())
+	{
+		Hits++;
+		created = false;
+		return it->second;
+	}
+
+	Misses++;
+	created = true;
+
+	PipelineEntry* entry = new PipelineEntry();
+	shard.Pipelines.emplace(description, entry);
+	return entry;
+}
+
+void VulkanPipelineCache::Compile(Shard& shard, PipelineEntry* entry, const PipelineDescription& description)
+{
+	PROFILE_SCOPE("CompilePipeline");
+
+	// Can take milliseconds, the shard stays usable in the meantime
+	ShaderModules modules = GetModules(description.Shader);
+	VulkanPipeline* pipeline = VulkanPipeline::Compile(Device, description, modules.Vertex, modules.Fragment);
+
+	std::vector<PipelineCallback> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(shard.Mutex);
+		entry->Pipeline.store(pipeline, std::memory_order_release);
+		callbacks.swap(entry->Callbacks);
+	}
+	shard.Compiled.notify_all();
+
+	for (PipelineCallback& callback : callbacks)
+	{
+		callback(pipeline);
+	}
+}
+
+VulkanPipelineCache::ShaderModules VulkanPipelineCache::GetModules(const VulkanShader* shader)
+{
+	std::lock_guard<std::mutex> lock(ModulesMutex);
+
+	ShaderModules& modules = Modules[shader];
+	if (modules.Vertex == VK_NULL_HANDLE)
+	{
+		modules.Vertex = VulkanPipeline::CreateShader(Device->Device, shader->VertexBytes);
+		modules.Fragment = VulkanPipeline::CreateShader(Device->Device, shader->FragmentBytes);
+	}
+
+	return modules;
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include "VulkanPipeline.h"
+
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class ThreadPool;
+
+typedef std::function<void(VulkanPipeline* pipeline)> PipelineCallback;
+
+struct PipelineEntry
+{
+	std::atomic<VulkanPipeline*> Pipeline{ nullptr };
+	std::atomic<bool> Claimed{ false }; // Whoever flips this compiles, the others wait or skip
+	std::vector<PipelineCallback> Callbacks; // Guarded by the shard's mutex
+};
+
+// Cheap to copy, stays valid until the device shuts down
+class PipelineHandle
+{
+public:
+	PipelineHandle() {}
+
+	bool IsValid() const { return Entry != nullptr; }
+	bool IsReady() const { return Entry != nullptr && Entry->Pipeline.load(std::memory_order_acquire) != nullptr; }
+
+	// Null until the compile finished
+	VulkanPipeline* Get() const { return Entry != nullptr ? Entry->Pipeline.load(std::memory_order_acquire) : nullptr; }
+	VulkanPipeline* GetOr(VulkanPipeline* fallback) const
+	{
+		VulkanPipeline* pipeline = Get();
+		return pipeline != nullptr ? pipeline : fallback;
+	}
+
+private:
+	friend class VulkanPipelineCache;
+
+	PipelineHandle(PipelineEntry* entry) : Entry(entry) {}
+
+	PipelineEntry* Entry = nullptr;
+};
+
+// Pipelines by description, split into independently locked shards so lookups from many threads
+// rarely contend. Each description is compiled exactly once, either on the thread pool (GetAsync)
+// or on the first thread that needs it right away (Get). Shader modules are created once per shader.
+class VulkanPipelineCache
+{
+public:
+	VulkanPipelineCache();
+
+	class VulkanDevice* Device;
+
+	// Async compiles run here, without a pool GetAsync compiles inline
+	ThreadPool* Workers = nullptr;
+
+	std::atomic<uint64_t> Hits;
+	std::atomic<uint64_t> Misses;
+
+	void Destroy();
+
+	// Thread safe, blocks until the pipeline is compiled
+	VulkanPipeline* Get(const PipelineDescription& description);
+
+	// Thread safe, returns right away. onReady is called once the pipeline exists, on the thread that
+	// compiled it, or right here if it already did.
+	PipelineHandle GetAsync(const PipelineDescription& description, PipelineCallback onReady = PipelineCallback());
+
+	// Blocks until every queued compile is done, for loading screens. Not from a pool thread.
+	void WaitAll();
+
+	uint32_t GetPendingCount();
+
+protected:
+	struct ShaderModules
+	{
+		VkShaderModule Vertex = VK_NULL_HANDLE;
+		VkShaderModule Fragment = VK_NULL_HANDLE;
+	};
+
+	struct Shard
+	{
+		std::mutex Mutex;
+		std::condition_variable Compiled;
+		std::unordered_map<PipelineDescription, PipelineEntry*, PipelineDescriptionHash> Pipelines;
+	};
+
+	static const uint32_t SHARD_COUNT = 16;
+	Shard Shards[SHARD_COUNT];
+
+	std::mutex ModulesMutex;
+	std::unordered_map<const VulkanShader*, ShaderModules> Modules;
+
+	std::mutex PendingMutex;
+	std::condition_variable PendingDone;
+	uint32_t Pending = 0;
+
+	Shard& GetShard(const PipelineDescription& description);
+
+	// Returns the entry, created tells whether this call inserted it
+	PipelineEntry* FindOrInsert(Shard& shard, const PipelineDescription& description, bool& created);
+
+	void Compile(Shard& shard, PipelineEntry* entry, const PipelineDescription& description);
+	ShaderModules GetModules(const VulkanShader* shader);
+};
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "VulkanProfiler.h"
+
+#include "VulkanDevice.h"
+#include "Trace.h"
+#include "Common.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+VulkanProfiler::VulkanProfiler()
+{
+}
+
+void VulkanProfiler::Create()
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(Device->PhysicalDevice, &familyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(Device->PhysicalDevice, &familyCount, families.data());
+
+	uint32_t validBits = families[Device->GraphicsFamily].timestampValidBits;
+	if (validBits == 0)
+	{
+		LOG_VK("Graphics queue has no timestamp support, GPU profiling disabled");
+		return;
+	}
+
+	TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	NanosecondsPerTick = Device->Properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = MAX_QUERIES * Device->FramesAhead;
+
+	VkResult result = vkCreateQueryPool(Device->Device, &createInfo, nullptr, &QueryPool);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create timestamp query pool");
+
+	Frames.resize(Device->FramesAhead);
+	Results.resize(MAX_QUERIES);
+
+	// Host domain has to match what steady_clock reads on this platform
+#ifdef _WIN32
+	HostDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+	HostDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+	if (Device->CalibratedTimestamps)
+	{
+		PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+			vkGetInstanceProcAddr(VulkanDevice::Instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+		GetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+			vkGetDeviceProcAddr(Device->Device, "vkGetCalibratedTimestampsEXT"));
+
+		bool hasDevice = false;
+		bool hasHost = false;
+		if (getTimeDomains != nullptr && GetCalibratedTimestamps != nullptr)
+		{
+			uint32_t domainCount = 0;
+			getTimeDomains(Device->PhysicalDevice, &domainCount, nullptr);
+
+			std::vector<VkTimeDomainEXT> domains(domainCount);
+			getTimeDomains(Device->PhysicalDevice, &domainCount, domains.data());
+
+			for (VkTimeDomainEXT domain : domains)
+			{
+				hasDevice |= domain == VK_TIME_DOMAIN_DEVICE_EXT;
+				hasHost |= domain == HostDomain;
+			}
+		}
+
+		Calibrated = hasDevice && hasHost;
+	}
+
+	Enabled = true;
+
+	Trace::SetThreadName(Trace::GpuThread, "GPU");
+
+	LOG_VK("GPU profiler: %u valid timestamp bits, %.2f ns per tick, %s", validBits, NanosecondsPerTick,
+		Calibrated ? "calibrated" : "anchored to submit");
+}
+
+void VulkanProfiler::Destroy()
+{
+	// Device is idle by now, flush the frames still in flight into the trace
+	for (uint32_t i = 0; i < Frames.size(); i++)
+	{
+		if (Frames[i].QueryCount > 0)
+		{
+			Resolve(Frames[i], i);
+		}
+	}
+
+	vkDestroyQueryPool(Device->Device, QueryPool, nullptr);
+	QueryPool = VK_NULL_HANDLE;
+
+	Frames.clear();
+	Enabled = false;
+}
+
+void VulkanProfiler::BeginFrame(VkCommandBuffer commandBuffer)
+{
+	if (!Enabled)
+		return;
+
+	uint32_t index = Device->CurrentFrame;
+	Frame& frame = Frames[index];
+
+	// The fence for this slot was just waited on, whatever it recorded last time is available now
+	if (frame.QueryCount > 0)
+	{
+		Resolve(frame, index);
+	}
+
+	frame.Zones.clear();
+	frame.Open.clear();
+	frame.QueryCount = 0;
+
+	vkCmdResetQueryPool(commandBuffer, QueryPool, index * MAX_QUERIES, MAX_QUERIES);
+
+	BeginZone(commandBuffer, "Frame");
+}
+
+void VulkanProfiler::EndFrame(VkCommandBuffer commandBuffer)
+{
+	if (!Enabled)
+		return;
+
+	Frame& frame = Frames[Device->CurrentFrame];
+	while (!frame.Open.empty())
+	{
+		EndZone(commandBuffer);
+	}
+}
+
+void VulkanProfiler::MarkSubmit()
+{
+	if (!Enabled)
+		return;
+
+	Frames[Device->CurrentFrame].SubmitTime = Trace::Now();
+}
+
+void VulkanProfiler::BeginZone(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (!Enabled)
+		return;
+
+	Frame& frame = Frames[Device->CurrentFrame];
+	if (frame.QueryCount + 2 > MAX_QUERIES)
+		return; // Out of queries, dropped zones are better than a crash
+
+	Zone zone;
+	zone.Name = name;
+	zone.BeginQuery = WriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	zone.EndQuery = frame.QueryCount++; // Reserved now so the end query always fits
+
+	frame.Open.push_back(static_cast<uint32_t>(frame.Zones.size()));
+	frame.Zones.push_back(zone);
+}
+
+void VulkanProfiler::EndZone(VkCommandBuffer commandBuffer)
+{
+	if (!Enabled)
+		return;
+
+	Frame& frame = Frames[Device->CurrentFrame];
+	if (frame.Open.empty())
+		return;
+
+	const Zone& zone = frame.Zones[frame.Open.back()];
+	frame.Open.pop_back();
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, QueryPool, Device->CurrentFrame * MAX_QUERIES + zone.EndQuery);
+}
+
+uint32_t VulkanProfiler::WriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage)
+{
+	Frame& frame = Frames[Device->CurrentFrame];
+	uint32_t query = frame.QueryCount++;
+
+	vkCmdWriteTimestamp(commandBuffer, stage, QueryPool, Device->CurrentFrame * MAX_QUERIES + query);
+	return query;
+}
+
+void VulkanProfiler::Resolve(Frame& frame, uint32_t index)
+{
+	VkResult result = vkGetQueryPoolResults(Device->Device, QueryPool, index * MAX_QUERIES, frame.QueryCount,
+		frame.QueryCount * sizeof(uint64_t), Results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return; // VK_NOT_READY, frame got skipped after recording started
+
+	for (uint32_t i = 0; i < frame.QueryCount; i++)
+	{
+		Results[i] &= TimestampMask;
+	}
+
+	// Zone 0 is the whole frame
+	const Zone& frameZone = frame.Zones[0];
+	uint64_t frameBegin = Results[frameZone.BeginQuery];
+
+	GpuFrameTime = ((Results[frameZone.EndQuery] - frameBegin) & TimestampMask) * NanosecondsPerTick / 1000000.0;
+	ResolvedFrames++;
+	AverageGpuFrameTime += (GpuFrameTime - AverageGpuFrameTime) / ResolvedFrames;
+
+	if (!Trace::IsOpen())
+		return;
+
+	// Without calibration assume the GPU picked the frame up right at submit, only relative timings are exact then
+	uint64_t gpuAnchor = frameBegin;
+	int64_t cpuAnchor = frame.SubmitTime;
+	if (Calibrated)
+	{
+		Calibrate(gpuAnchor, cpuAnchor);
+	}
+
+	for (const Zone& zone : frame.Zones)
+	{
+		int64_t begin = cpuAnchor + static_cast<int64_t>(static_cast<int64_t>(Results[zone.BeginQuery] - gpuAnchor) * NanosecondsPerTick);
+		int64_t end = cpuAnchor + static_cast<int64_t>(static_cast<int64_t>(Results[zone.EndQuery] - gpuAnchor) * NanosecondsPerTick);
+
+		Trace::Complete(zone.Name, Trace::GpuThread, begin, end);
+	}
+}
+
+bool VulkanProfiler::Calibrate(uint64_t& gpuTicks, int64_t& cpuTime) const
+{
+	VkCalibratedTimestampInfoEXT infos[2] = {};
+	infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[1].timeDomain = HostDomain;
+
+	uint64_t timestamps[2];
+	uint64_t maxDeviation;
+	if (GetCalibratedTimestamps(Device->Device, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS)
+		return false;
+
+	gpuTicks = timestamps[0] & TimestampMask;
+
+#ifdef _WIN32
+	// Same conversion steady_clock does, split to avoid overflowing
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	uint64_t counter = timestamps[1];
+	uint64_t ticksPerSecond = static_cast<uint64_t>(frequency.QuadPart);
+	cpuTime = static_cast<int64_t>((counter / ticksPerSecond) * 1000000000ull + (counter % ticksPerSecond) * 1000000000ull / ticksPerSecond);
+#else
+	cpuTime = static_cast<int64_t>(timestamps[1]);
+#endif
+
+	return true;
+}
\ No newline at end of file
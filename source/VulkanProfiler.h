@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <vector>
+#include <cstdint>
+
+// GPU timestamp zones, nestable, recorded into the frame's primary command buffer.
+// Results are read back once the frame's fence has been waited on again, FramesAhead frames later,
+// so resolving never stalls. Zones are converted to CPU time and streamed to the trace if one is open.
+class VulkanProfiler
+{
+public:
+	VulkanProfiler();
+
+	class VulkanDevice* Device;
+
+	bool Enabled = false; // Queue family has no timestamp support otherwise
+	bool Calibrated = false; // VK_EXT_calibrated_timestamps, otherwise frames are anchored to their submit
+
+	// Last resolved frame, milliseconds
+	double GpuFrameTime = 0.0;
+	double AverageGpuFrameTime = 0.0; // Over all resolved frames
+	uint64_t ResolvedFrames = 0;
+
+	void Create();
+	void Destroy();
+
+	// After the frame's fence was waited on and the command buffer began recording, outside a render pass
+	void BeginFrame(VkCommandBuffer commandBuffer);
+	// Right before vkEndCommandBuffer
+	void EndFrame(VkCommandBuffer commandBuffer);
+	// CPU time the frame was handed to the queue
+	void MarkSubmit();
+
+	// Name has to be a string literal or otherwise outlive the frame
+	void BeginZone(VkCommandBuffer commandBuffer, const char* name);
+	void EndZone(VkCommandBuffer commandBuffer);
+
+protected:
+	struct Zone
+	{
+		const char* Name = nullptr;
+		uint32_t BeginQuery = 0;
+		uint32_t EndQuery = 0;
+	};
+
+	struct Frame
+	{
+		std::vector<Zone> Zones;
+		std::vector<uint32_t> Open; // Zone stack
+		uint32_t QueryCount = 0;
+		int64_t SubmitTime = 0;
+	};
+
+	const uint32_t MAX_QUERIES = 256; // Per frame, two per zone
+
+	VkQueryPool QueryPool = VK_NULL_HANDLE;
+	std::vector<Frame> Frames;
+	std::vector<uint64_t> Results;
+
+	uint64_t TimestampMask = ~0ull;
+	double NanosecondsPerTick = 1.0;
+
+	VkTimeDomainEXT HostDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	PFN_vkGetCalibratedTimestampsEXT GetCalibratedTimestamps = nullptr;
+
+	uint32_t WriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage);
+	void Resolve(Frame& frame, uint32_t index);
+
+	// GPU tick and steady clock nanoseconds taken at the same moment
+	bool Calibrate(uint64_t& gpuTicks, int64_t& cpuTime) const;
+};
\ No newline at end of file
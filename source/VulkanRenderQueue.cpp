@@ -0,0 +1,306 @@
+#include "VulkanRenderQueue.h"
+
+#include "Common.h"
+#include "VulkanDevice.h"
+#include "VulkanPipeline.h"
+#include "VulkanBuffer.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+VulkanRenderQueue::VulkanRenderQueue()
+{
+}
+
+void VulkanRenderQueue::Reset()
+{
+	Packets.clear();
+	Entries.clear();
+
+	PipelineIds.Clear();
+	SetIds.Clear();
+	GeometryIds.Clear();
+
+	std::lock_guard<std::mutex> lock(StatisticsMutex);
+	Totals = Statistics();
+}
+
+void VulkanRenderQueue::Submit(const RenderPacket& packet)
+{
+	CRITICAL_ASSERT(packet.Pipeline != nullptr && packet.Geometry.IsValid(), "Render packets need a pipeline and geometry");
+	CRITICAL_ASSERT(packet.PushConstantSize <= sizeof(packet.PushConstants), "Render packets push at most %u bytes", static_cast<uint32_t>(sizeof(packet.PushConstants)));
+
+	SortEntry entry;
+	entry.Key = MakeKey(packet);
+	entry.Packet = static_cast<uint32_t>(Packets.size());
+
+	Packets.push_back(packet);
+	Entries.push_back(entry);
+}
+
+void VulkanRenderQueue::Sort()
+{
+	PROFILE_SCOPE("RenderQueue::Sort");
+
+	if (Entries.size() > 1)
+	{
+		RadixSort();
+	}
+}
+
+uint32_t VulkanRenderQueue::IdTable::Get(uint64_t a, uint64_t b, uint32_t bits)
+{
+	// At most half full, probes stay short
+	if ((Count + 1) * 2 > Slots.size())
+	{
+		Grow();
+	}
+
+	size_t mask = Slots.size() - 1;
+	for (size_t i = Hash(a, b) & mask; ; i = (i + 1) & mask)
+	{
+		Slot& slot = Slots[i];
+		if (slot.Generation != Generation)
+		{
+			slot.A = a;
+			slot.B = b;
+			slot.Id = std::min(Count, (1u << bits) - 1);
+			slot.Generation = Generation;
+			Count++;
+			return slot.Id;
+		}
+
+		if (slot.A == a && slot.B == b)
+			return slot.Id;
+	}
+}
+
+void VulkanRenderQueue::IdTable::Clear()
+{
+	Count = 0;
+	Generation++;
+
+	// Wrapped, old slots could match again
+	if (Generation == 0)
+	{
+		for (Slot& slot : Slots)
+		{
+			slot.Generation = 0;
+		}
+		Generation = 1;
+	}
+}
+
+void VulkanRenderQueue::IdTable::Grow()
+{
+	std::vector<Slot> old;
+	old.swap(Slots);
+	Slots.resize(std::max<size_t>(old.size() * 2, 64));
+
+	size_t mask = Slots.size() - 1;
+	for (const Slot& slot : old)
+	{
+		if (slot.Generation != Generation)
+			continue;
+
+		size_t i = Hash(slot.A, slot.B) & mask;
+		while (Slots[i].Generation == Generation)
+		{
+			i = (i + 1) & mask;
+		}
+		Slots[i] = slot;
+	}
+}
+
+size_t VulkanRenderQueue::IdTable::Hash(uint64_t a, uint64_t b)
+{
+	// Handles and pointers are aligned, the multiply moves their entropy into the high bits and the shift back down
+	uint64_t hash = (a ^ (b * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull;
+	return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+uint64_t VulkanRenderQueue::MakeKey(const RenderPacket& packet)
+{
+	uint64_t pipeline = PipelineIds.Get(reinterpret_cast<uint64_t>(packet.Pipeline), 0, PIPELINE_BITS);
+
+	uint64_t set = 0;
+	if (packet.Uniforms.Data != nullptr)
+	{
+		// 0 is left for packets without uniforms
+		VkDescriptorSet packetSet = packet.Uniforms.Usage == FrameUsage::Storage ? Device->FrameAllocator.StorageSet : Device->FrameAllocator.UniformSet;
+		set = 1 + SetIds.Get(reinterpret_cast<uint64_t>(packetSet), packet.Uniforms.Offset, SET_BITS);
+		set = std::min<uint64_t>(set, (1ull << SET_BITS) - 1);
+	}
+
+	uint64_t geometry = GeometryIds.Get(reinterpret_cast<uint64_t>(packet.Geometry.VertexBuffer), reinterpret_cast<uint64_t>(packet.Geometry.IndexBuffer), GEOMETRY_BITS);
+
+	const uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+	uint64_t depth = static_cast<uint64_t>(std::min(std::max(packet.Depth, 0.0f), 1.0f) * depthMax);
+
+	uint64_t key = static_cast<uint64_t>(packet.Pass) << (64 - PASS_BITS);
+	if (packet.Pass == DrawPass::Transparent)
+	{
+		// Blending needs the order, state only breaks ties
+		key |= (depthMax - depth) << (PIPELINE_BITS + SET_BITS + GEOMETRY_BITS);
+		key |= pipeline << (SET_BITS + GEOMETRY_BITS);
+		key |= set << GEOMETRY_BITS;
+		key |= geometry;
+	}
+	else
+	{
+		key |= pipeline << (SET_BITS + GEOMETRY_BITS + DEPTH_BITS);
+		key |= set << (GEOMETRY_BITS + DEPTH_BITS);
+		key |= geometry << DEPTH_BITS;
+		key |= depth;
+	}
+
+	return key;
+}
+
+void VulkanRenderQueue::RadixSort()
+{
+	// LSD over bytes, stable so equal keys keep their submission order
+	const uint32_t DIGITS = 8;
+	uint32_t counts[DIGITS][256] = {};
+
+	for (const SortEntry& entry : Entries)
+	{
+		for (uint32_t digit = 0; digit < DIGITS; digit++)
+		{
+			counts[digit][(entry.Key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	size_t size = Entries.size();
+	Scratch.resize(size);
+
+	for (uint32_t digit = 0; digit < DIGITS; digit++)
+	{
+		uint32_t shift = digit * 8;
+		uint32_t* count = counts[digit];
+
+		// Every key has the same byte here, the pass would only copy. Most are with few ids in use.
+		if (count[(Entries[0].Key >> shift) & 0xFF] == size)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketCount = count[bucket];
+			count[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (const SortEntry& entry : Entries)
+		{
+			Scratch[count[(entry.Key >> shift) & 0xFF]++] = entry;
+		}
+
+		Entries.swap(Scratch);
+	}
+}
+
+void VulkanRenderQueue::Execute(uint32_t first, uint32_t count)
+{
+	PROFILE_SCOPE("RenderQueue::Execute");
+
+	uint32_t end = std::min(first + count, GetPacketCount());
+	Statistics statistics;
+
+	// What's bound on the command buffer, nothing yet
+	const VulkanPipeline* pipeline = nullptr;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	uint32_t setOffset = 0;
+	uint32_t constants[4] = {};
+	uint32_t constantSize = 0;
+	const VulkanBuffer* vertexBuffer = nullptr;
+	const VulkanBuffer* indexBuffer = nullptr;
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	uint32_t instanceOffset = 0;
+
+	for (uint32_t i = first; i < end; i++)
+	{
+		const RenderPacket& packet = Packets[Entries[i].Packet];
+
+		if (packet.Pipeline != pipeline)
+		{
+			pipeline = packet.Pipeline;
+			Device->BindPipeline(pipeline);
+			statistics.PipelineBinds++;
+
+			// Sets stay bound across pipelines with the same layout, the cache hands out one per signature
+			if (pipeline->PipelineLayout != layout)
+			{
+				layout = pipeline->PipelineLayout;
+				set = VK_NULL_HANDLE;
+				constantSize = 0;
+
+				if (pipeline->UsesBindless)
+				{
+					Device->BindBindless(pipeline);
+					statistics.SetBinds++;
+				}
+			}
+		}
+
+		if (packet.PushConstantSize > 0 && (packet.PushConstantSize != constantSize || memcmp(packet.PushConstants, constants, constantSize) != 0))
+		{
+			constantSize = packet.PushConstantSize;
+			memcpy(constants, packet.PushConstants, constantSize);
+			Device->PushConstants(pipeline, constants, constantSize);
+			statistics.Pushes++;
+		}
+
+		if (packet.Uniforms.Data != nullptr)
+		{
+			VkDescriptorSet packetSet = packet.Uniforms.Usage == FrameUsage::Storage ? Device->FrameAllocator.StorageSet : Device->FrameAllocator.UniformSet;
+			if (packetSet != set || packet.Uniforms.Offset != setOffset)
+			{
+				set = packetSet;
+				setOffset = packet.Uniforms.Offset;
+				Device->BindFrameAllocation(pipeline, 0, packet.Uniforms);
+				statistics.SetBinds++;
+			}
+		}
+
+		if (packet.Geometry.VertexBuffer != vertexBuffer)
+		{
+			vertexBuffer = packet.Geometry.VertexBuffer;
+			Device->BindVertexBuffer(vertexBuffer);
+			statistics.BufferBinds++;
+		}
+
+		if (packet.Geometry.IndexBuffer != indexBuffer)
+		{
+			indexBuffer = packet.Geometry.IndexBuffer;
+			Device->BindIndexBuffer(indexBuffer);
+			statistics.BufferBinds++;
+		}
+
+		if (packet.Instances.Data != nullptr && (packet.Instances.Buffer != instanceBuffer || packet.Instances.Offset != instanceOffset))
+		{
+			instanceBuffer = packet.Instances.Buffer;
+			instanceOffset = packet.Instances.Offset;
+			Device->BindInstanceBuffer(packet.Instances);
+			statistics.BufferBinds++;
+		}
+
+		Device->DrawGeometry(packet.Geometry, packet.InstanceCount, packet.FirstInstance);
+		statistics.Draws++;
+	}
+
+	std::lock_guard<std::mutex> lock(StatisticsMutex);
+	Totals.Draws += statistics.Draws;
+	Totals.PipelineBinds += statistics.PipelineBinds;
+	Totals.SetBinds += statistics.SetBinds;
+	Totals.BufferBinds += statistics.BufferBinds;
+	Totals.Pushes += statistics.Pushes;
+}
+
+VulkanRenderQueue::Statistics VulkanRenderQueue::GetStatistics() const
+{
+	std::lock_guard<std::mutex> lock(StatisticsMutex);
+	return Totals;
+}
\ No newline at end of file
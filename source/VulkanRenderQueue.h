@@ -0,0 +1,134 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include "VulkanFrameAllocator.h"
+#include "VulkanGeometryPool.h"
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+class VulkanPipeline;
+
+// Sorted front to back inside a pass, Transparent back to front and ahead of any state
+enum class DrawPass : uint8_t
+{
+	Opaque,
+	Transparent
+};
+
+// Everything one draw needs, binds are derived from it when the queue is executed
+struct RenderPacket
+{
+	const VulkanPipeline* Pipeline = nullptr;
+	FrameAllocation Uniforms; // Set 0 through the frame allocator's sets, none if Data is null
+	GeometryHandle Geometry;
+	FrameAllocation Instances; // Binding 1, none if Data is null
+	uint32_t InstanceCount = 1;
+	uint32_t FirstInstance = 0;
+
+	// Pushed from offset 0, usually the material's bindless handles. Not part of the key, so draws that
+	// only differ in these still batch.
+	uint32_t PushConstants[4] = {};
+	uint32_t PushConstantSize = 0; // Bytes, 0 pushes nothing
+
+	DrawPass Pass = DrawPass::Opaque;
+	float Depth = 0.0f; // 0..1, view depth for ordering inside the pass
+};
+
+// Collects a frame's draws, radix sorts them by a 64 bit key and records them with only the binds that
+// actually change something. Opaque keys are pass | pipeline | set | geometry buffers | depth, so draws
+// sharing state end up next to each other. The ids in the key are handed out per frame in the order
+// things are first seen; once a field runs out of bits the rest share its last id, which only costs
+// sorting quality since the emitted binds compare the real state.
+class VulkanRenderQueue
+{
+public:
+	VulkanRenderQueue();
+
+	class VulkanDevice* Device;
+
+	struct Statistics
+	{
+		uint32_t Draws = 0;
+		uint32_t PipelineBinds = 0;
+		uint32_t SetBinds = 0; // Including the bindless set
+		uint32_t Pushes = 0;
+		uint32_t BufferBinds = 0; // Vertex, index and instance
+	};
+
+	// Main thread, called by the device's BeginFrame
+	void Reset();
+
+	// Main thread, between BeginFrame and Sort
+	void Submit(const RenderPacket& packet);
+
+	// Main thread, once all packets are in
+	void Sort();
+
+	// Records packets [first, first + count) of the sorted order. Any thread, every call starts with
+	// nothing bound so ranges can go to different secondaries.
+	void Execute(uint32_t first, uint32_t count);
+	void Execute() { Execute(0, GetPacketCount()); }
+
+	uint32_t GetPacketCount() const { return static_cast<uint32_t>(Packets.size()); }
+
+	// Summed over the frame's Execute calls, read after recording
+	Statistics GetStatistics() const;
+
+protected:
+	// Field widths of the sort key, pass takes the top bits
+	static const uint32_t PASS_BITS = 2;
+	static const uint32_t PIPELINE_BITS = 14;
+	static const uint32_t SET_BITS = 12;
+	static const uint32_t GEOMETRY_BITS = 12;
+	static const uint32_t DEPTH_BITS = 24;
+
+	struct SortEntry
+	{
+		uint64_t Key;
+		uint32_t Packet;
+	};
+
+	std::vector<RenderPacket> Packets;
+	std::vector<SortEntry> Entries;
+	std::vector<SortEntry> Scratch;
+
+	// Ids in first seen order for a key of two words. Open addressing over slots that are kept across frames,
+	// a clear only bumps the generation, so once the table has grown no frame allocates.
+	class IdTable
+	{
+	public:
+		uint32_t Get(uint64_t a, uint64_t b, uint32_t bits);
+		void Clear();
+
+	protected:
+		struct Slot
+		{
+			uint64_t A = 0;
+			uint64_t B = 0;
+			uint32_t Id = 0;
+			uint32_t Generation = 0; // Empty unless it matches the table's
+		};
+
+		std::vector<Slot> Slots;
+		uint32_t Count = 0;
+		uint32_t Generation = 1;
+
+		void Grow();
+		static size_t Hash(uint64_t a, uint64_t b);
+	};
+
+	// Per frame ids
+	IdTable PipelineIds;
+	IdTable SetIds; // Set and dynamic offset
+	IdTable GeometryIds; // Vertex and index buffer
+
+	// Added to by concurrent Execute calls
+	Statistics Totals;
+	mutable std::mutex StatisticsMutex;
+
+	uint64_t MakeKey(const RenderPacket& packet);
+	void RadixSort();
+};
\ No newline at end of file
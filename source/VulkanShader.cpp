@@ -1,2 +1,36 @@
 #include "VulkanShader.h"
 
+#include "Common.h"
+
+VulkanShader* VulkanShader::CreateFromSPIRV(File::MappedFile vertexFile, File::MappedFile fragmentFile)
+{
+	VulkanShader* shader = new VulkanShader();
+
+	shader->VertexFile = std::move(vertexFile);
+	shader->FragmentFile = std::move(fragmentFile);
+	shader->VertexBytes = shader->VertexFile.View();
+	shader->FragmentBytes = shader->FragmentFile.View();
+	shader->Reflect();
+
+	return shader;
+}
+
+VulkanShader* VulkanShader::CreateFromSPIRV(File::ByteView vertexBytes, File::ByteView fragmentBytes)
+{
+	VulkanShader* shader = new VulkanShader();
+
+	shader->VertexBytes = vertexBytes;
+	shader->FragmentBytes = fragmentBytes;
+	shader->Reflect();
+
+	return shader;
+}
+
+void VulkanShader::Reflect()
+{
+	bool valid = SpirvReflection::Reflect(VertexBytes, VertexReflection);
+	CRITICAL_ASSERT(valid && VertexReflection.Stage == VK_SHADER_STAGE_VERTEX_BIT, "Invalid vertex shader SPIR-V");
+
+	valid = SpirvReflection::Reflect(FragmentBytes, FragmentReflection);
+	CRITICAL_ASSERT(valid && FragmentReflection.Stage == VK_SHADER_STAGE_FRAGMENT_BIT, "Invalid fragment shader SPIR-V");
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "File.h"
+#include "SpirvReflection.h"
+
 #include <vector>
 
 class VulkanShader
@@ -7,16 +10,22 @@ class VulkanShader
 public:
 	VulkanShader() {}
 
-	std::vector<uint8_t> VertexBytes;
-	std::vector<uint8_t> FragmentBytes;
+	// SPIR-V code, points into the mapped files below or memory the creator keeps alive
+	File::ByteView VertexBytes;
+	File::ByteView FragmentBytes;
+
+	File::MappedFile VertexFile;
+	File::MappedFile FragmentFile;
+
+	ShaderReflection VertexReflection;
+	ShaderReflection FragmentReflection;
 
-	static VulkanShader* CreateFromSPIRV(std::vector<uint8_t> vertexBytes, std::vector<uint8_t> fragmentBytes)
-	{
-		VulkanShader* shader = new VulkanShader();
+	// Takes ownership of the mappings, the code is consumed straight from the page cache
+	static VulkanShader* CreateFromSPIRV(File::MappedFile vertexFile, File::MappedFile fragmentFile);
 
-		shader->VertexBytes = vertexBytes;
-		shader->FragmentBytes = fragmentBytes;
+	// Code has to outlive the shader
+	static VulkanShader* CreateFromSPIRV(File::ByteView vertexBytes, File::ByteView fragmentBytes);
 
-		return shader;
-	}
+protected:
+	void Reflect();
 };
\ No newline at end of file
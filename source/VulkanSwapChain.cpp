@@ -3,97 +3,198 @@
 #include "VulkanDevice.h"
 #include "Common.h"
 
+#include "SDL2/SDL_vulkan.h"
+
 VulkanSwapchain::VulkanSwapchain()
 {
 }
 
 void VulkanSwapchain::Create(uint32_t width, uint32_t height)
 {
-	VkSurfaceCapabilitiesKHR capabilities;
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Device->PhysicalDevice, Surface, &capabilities);
+	if (Device->Headless)
+	{
+		CreateOffscreenImages(width, height);
+	}
+	else
+	{
+		CreateSurfaceImages(width, height);
+	}
 
-	uint32_t formatCount = 0;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(Device->PhysicalDevice, Surface, &formatCount, nullptr);
+	if (UseDepth)
+	{
+		SelectDepthFormat();
+	}
 
-	std::vector<VkSurfaceFormatKHR> availableFormats(formatCount);
-	vkGetPhysicalDeviceSurfaceFormatsKHR(Device->PhysicalDevice, Surface, &formatCount, availableFormats.data());
+	CreateDepth();
+	CreateRenderPass();
+	CreateFramebuffers();
 
-	// Format
-	VkSurfaceFormatKHR surfaceFormat = availableFormats[0]; // Just pick the first available format
+	// Endlog
+	printf("# of images : %zd\n", Images.size());
+}
 
-	// Present Mode
-	VkPresentModeKHR presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; // No vsync
+void VulkanSwapchain::Recreate(uint32_t width, uint32_t height)
+{
+	// Whatever is still in flight keeps using the old views/framebuffers, so they are only
+	// destroyed once the frames that might reference them have retired instead of idling the device
+	RetiredSwapchain retired;
+	retired.Swapchain = Swapchain;
+	retired.ImageViews = std::move(ImageViews);
+	retired.Framebuffers = std::move(Framebuffers);
+	retired.DepthImage = DepthImage;
+	retired.DepthAllocation = DepthAllocation;
+	retired.DepthView = DepthView;
+	retired.Frame = Device->FrameCount;
+	Retired.push_back(std::move(retired));
+
+	ImageViews.clear();
+	Framebuffers.clear();
+
+	CreateSurfaceImages(width, height); // Passes the current swapchain along as oldSwapchain
+	CreateDepth();
+	CreateFramebuffers();
+
+	OutOfDate = false;
+
+	LOG_VK("Swapchain recreated (%ux%u, %zu images)", Extent.width, Extent.height, Images.size());
+}
 
-	// Extent
-	VkExtent2D extent = {};
-	if (capabilities.currentExtent.width == UINT32_MAX ||
-		capabilities.currentExtent.height == UINT32_MAX)
+void VulkanSwapchain::Destroy()
+{
+	// Expects the device to be idle
+	DestroyRetired(true);
+
+	for (VkFramebuffer framebuffer : Framebuffers)
 	{
-		extent.width = width;
-		extent.height = height;
+		vkDestroyFramebuffer(Device->Device, framebuffer, nullptr);
 	}
-	else
+	for (VkImageView view : ImageViews)
 	{
-		extent = capabilities.currentExtent;
+		vkDestroyImageView(Device->Device, view, nullptr);
 	}
-
-	uint32_t imageCount = capabilities.minImageCount + 1;
-	if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+	for (size_t i = 0; i < ImageAllocations.size(); i++)
 	{
-		imageCount = capabilities.maxImageCount;
+		vmaDestroyImage(Device->Allocator, Images[i], ImageAllocations[i]);
 	}
 
-	VkSwapchainCreateInfoKHR swapchainInfo = {};
-	swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	swapchainInfo.surface = Surface;
-	swapchainInfo.minImageCount = imageCount;
-	swapchainInfo.imageFormat = surfaceFormat.format;
-	swapchainInfo.imageColorSpace = surfaceFormat.colorSpace;
-	swapchainInfo.imageExtent = extent;
-	swapchainInfo.imageArrayLayers = 1;
-	swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	swapchainInfo.preTransform = capabilities.currentTransform;
-	swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	swapchainInfo.presentMode = presentMode;
-	swapchainInfo.clipped = VK_TRUE;
-	swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
+	vkDestroyImageView(Device->Device, DepthView, nullptr);
+	vmaDestroyImage(Device->Allocator, DepthImage, DepthAllocation);
+	DepthView = VK_NULL_HANDLE;
+	DepthImage = VK_NULL_HANDLE;
+	DepthAllocation = nullptr;
 
-	VkResult result = vkCreateSwapchainKHR(Device->Device, &swapchainInfo, nullptr, &Swapchain);
-	CRITICAL_ASSERT(result == VK_SUCCESS, "Swapchain creation failed");
+	Framebuffers.clear();
+	ImageViews.clear();
+	ImageAllocations.clear();
+	Images.clear();
 
-	Images.resize(imageCount);
-	vkGetSwapchainImagesKHR(Device->Device, Swapchain, &imageCount, Images.data());
+	vkDestroyRenderPass(Device->Device, RenderPass, nullptr);
+	RenderPass = VK_NULL_HANDLE;
 
-	ImageFormat = surfaceFormat.format;
-	Extent = extent;
+	if (Swapchain != VK_NULL_HANDLE)
+	{
+		vkDestroySwapchainKHR(Device->Device, Swapchain, nullptr);
+		Swapchain = VK_NULL_HANDLE;
+	}
+}
 
-	// Image Views
-	ImageViews.resize(imageCount);
-	for (size_t i = 0; i < Images.size(); i++)
+void VulkanSwapchain::DestroyRetired(bool all)
+{
+	size_t retired = 0;
+	for (; retired < Retired.size(); retired++)
 	{
-		VkImageViewCreateInfo createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		createInfo.image = Images[i];
-		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		createInfo.format = ImageFormat;
+		RetiredSwapchain& old = Retired[retired];
+		if (!all && !Device->IsFrameRetired(old.Frame))
+			break;
+
+		for (VkFramebuffer framebuffer : old.Framebuffers)
+		{
+			vkDestroyFramebuffer(Device->Device, framebuffer, nullptr);
+		}
+		for (VkImageView view : old.ImageViews)
+		{
+			vkDestroyImageView(Device->Device, view, nullptr);
+		}
+		vkDestroyImageView(Device->Device, old.DepthView, nullptr);
+		vmaDestroyImage(Device->Allocator, old.DepthImage, old.DepthAllocation);
+		vkDestroySwapchainKHR(Device->Device, old.Swapchain, nullptr);
+	}
 
-		createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	Retired.erase(Retired.begin(), Retired.begin() + retired);
+}
 
-		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		createInfo.subresourceRange.baseMipLevel = 0;
-		createInfo.subresourceRange.levelCount = 1;
-		createInfo.subresourceRange.baseArrayLayer = 0;
-		createInfo.subresourceRange.layerCount = 1;
+void VulkanSwapchain::SelectDepthFormat()
+{
+	// The depth pyramid samples it, so attachment support alone isn't enough. Only one of D32 and X8_D24 is
+	// guaranteed as an attachment, D16 always is and is sampleable too, so the list never runs out.
+	const VkFormat candidates[] =
+	{
+		VK_FORMAT_D32_SFLOAT,
+		VK_FORMAT_X8_D24_UNORM_PACK32,
+		VK_FORMAT_D24_UNORM_S8_UINT,
+		VK_FORMAT_D32_SFLOAT_S8_UINT,
+		VK_FORMAT_D16_UNORM
+	};
 
-		VkResult result = vkCreateImageView(Device->Device, &createInfo, nullptr, &ImageViews[i]);
-		CRITICAL_ASSERT(result == VK_SUCCESS, "Swapchain creation failed");
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+	DepthFormat = VK_FORMAT_UNDEFINED;
+	for (VkFormat format : candidates)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(Device->PhysicalDevice, format, &properties);
+		if ((properties.optimalTilingFeatures & required) == required)
+		{
+			DepthFormat = format;
+			break;
+		}
 	}
 
-	// Render Pass
+	CRITICAL_ASSERT(DepthFormat != VK_FORMAT_UNDEFINED, "No sampleable depth format");
+	LOG_VK("Depth format: %d", DepthFormat);
+}
+
+void VulkanSwapchain::CreateDepth()
+{
+	Generation++;
+
+	if (!UseDepth)
+		return;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = DepthFormat;
+	imageInfo.extent = { Extent.width, Extent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocationInfo = {};
+	allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VkResult result = vmaCreateImage(Device->Allocator, &imageInfo, &allocationInfo, &DepthImage, &DepthAllocation, nullptr);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Depth image creation failed");
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = DepthImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = DepthFormat;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(Device->Device, &viewInfo, nullptr, &DepthView);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Depth view creation failed");
+}
+
+void VulkanSwapchain::CreateRenderPass()
+{
 	VkAttachmentDescription colorAttachment = {};
 	colorAttachment.format = ImageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -102,68 +203,168 @@ void VulkanSwapchain::Create(uint32_t width, uint32_t height)
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = Device->Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentReference = {};
 	colorAttachmentReference.attachment = 0;
 	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	// Cleared every frame, stored for the next frame's occlusion tests
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = DepthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentReference = {};
+	depthAttachmentReference.attachment = 1;
+	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 	VkSubpassDescription subpass = {};
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentReference;
+	subpass.pDepthStencilAttachment = UseDepth ? &depthAttachmentReference : nullptr;
+
+	// The depth image is shared across frames in flight: the last pass (and the pyramid build reading it)
+	// have to be done before it's cleared again, and this pass's writes have to land before compute reads them
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
 
 	VkRenderPassCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	createInfo.attachmentCount = 1;
-	createInfo.pAttachments = &colorAttachment;
+	createInfo.attachmentCount = UseDepth ? 2 : 1;
+	createInfo.pAttachments = attachments;
 	createInfo.subpassCount = 1;
 	createInfo.pSubpasses = &subpass;
+	createInfo.dependencyCount = 2;
+	createInfo.pDependencies = dependencies;
 
-	result = vkCreateRenderPass(Device->Device, &createInfo, nullptr, &RenderPass);
+	VkResult result = vkCreateRenderPass(Device->Device, &createInfo, nullptr, &RenderPass);
 	CRITICAL_ASSERT(result == VK_SUCCESS, "Swapchain creation failed");
+}
+
+void VulkanSwapchain::CreateFramebuffers()
+{
+	uint32_t imageCount = static_cast<uint32_t>(Images.size());
+
+	// Image Views
+	VkResult result;
+	ImageViews.resize(imageCount);
+	for (size_t i = 0; i < Images.size(); i++)
+	{
+		VkImageViewCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image = Images[i];
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format = ImageFormat;
+
+		createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		createInfo.subresourceRange.baseMipLevel = 0;
+		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView(Device->Device, &createInfo, nullptr, &ImageViews[i]);
+		CRITICAL_ASSERT(result == VK_SUCCESS, "Swapchain creation failed");
+	}
 
 	// Framebuffers
 	Framebuffers.resize(ImageViews.size());
 
 	for (size_t i = 0; i < ImageViews.size(); i++)
 	{
-		VkImageView attachments[] = { ImageViews[i] };
+		VkImageView attachments[] = { ImageViews[i], DepthView };
 
 		VkFramebufferCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		createInfo.renderPass = RenderPass;
-		createInfo.attachmentCount = 1;
+		createInfo.attachmentCount = UseDepth ? 2 : 1;
 		createInfo.pAttachments = attachments;
-		createInfo.width = width;
-		createInfo.height = height;
+		createInfo.width = Extent.width;
+		createInfo.height = Extent.height;
 		createInfo.layers = 1;
 
 		result = vkCreateFramebuffer(Device->Device, &createInfo, nullptr, &Framebuffers[i]);
 		CRITICAL_ASSERT(result == VK_SUCCESS, "Swapchain!!!");
 	}
-
-
-	// Endlog
-	printf("# of images : %zd\n", Images.size());
 }
 
-uint32_t VulkanSwapchain::NextImage(VkSemaphore semaphore)
+bool VulkanSwapchain::NextImage(VkSemaphore semaphore)
 {
-	VkResult result = vkAcquireNextImageKHR(Device->Device, Swapchain, UINT64_MAX, semaphore, VK_NULL_HANDLE, &CurrentImage);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	if (Device->Headless)
 	{
-		CRITICAL_ERROR("WOOPS");
+		CurrentImage = (CurrentImage + 1) % static_cast<uint32_t>(Images.size());
+		return true;
 	}
-	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+
+	DestroyRetired(false);
+
+	for (uint32_t attempt = 0; attempt < 2; attempt++)
 	{
-		CRITICAL_ERROR("swapchain bad");
+		if (OutOfDate)
+		{
+			VkExtent2D extent = GetSurfaceExtent();
+			if (extent.width == 0 || extent.height == 0)
+			{
+				return false; // Minimized, nothing to render into
+			}
+
+			Recreate(extent.width, extent.height);
+		}
+
+		VkResult result = vkAcquireNextImageKHR(Device->Device, Swapchain, UINT64_MAX, semaphore, VK_NULL_HANDLE, &CurrentImage);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			// Semaphore wasn't touched, safe to recreate and try again right away
+			OutOfDate = true;
+			continue;
+		}
+		else if (result == VK_SUBOPTIMAL_KHR)
+		{
+			// Image is acquired and the semaphore will signal, use it and recreate after presenting
+			OutOfDate = true;
+		}
+		else if (result != VK_SUCCESS)
+		{
+			CRITICAL_ERROR("swapchain bad");
+		}
+
+		return true;
 	}
 
-	return CurrentImage;
+	return false;
 }
 
 void VulkanSwapchain::Present(VkSemaphore waitSemaphore)
 {
+	if (Device->Headless)
+	{
+		return; // Nothing to present, the offscreen image is simply left as rendered
+	}
+
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.swapchainCount = 1;
@@ -176,8 +377,191 @@ void VulkanSwapchain::Present(VkSemaphore waitSemaphore)
 	if (result == VK_ERROR_OUT_OF_DATE_KHR ||
 		result == VK_SUBOPTIMAL_KHR)
 	{
-		CRITICAL_ERROR("swapchain suboptimial/out of date");
+		OutOfDate = true; // Picked up by the next NextImage
+	}
+	else if (result != VK_SUCCESS)
+	{
+		CRITICAL_ERROR("swapchain present failed");
 	}
 
 	//currentFrame = (currentFrame + 1) % maxFramesInFlight;
+}
+
+void VulkanSwapchain::CreateSurfaceImages(uint32_t width, uint32_t height)
+{
+	VkSurfaceCapabilitiesKHR capabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Device->PhysicalDevice, Surface, &capabilities);
+
+	uint32_t formatCount = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(Device->PhysicalDevice, Surface, &formatCount, nullptr);
+
+	std::vector<VkSurfaceFormatKHR> availableFormats(formatCount);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(Device->PhysicalDevice, Surface, &formatCount, availableFormats.data());
+
+	// Format
+	VkSurfaceFormatKHR surfaceFormat = availableFormats[0]; // Just pick the first available format
+
+	// Recreation has to stay render pass compatible with the existing pipelines
+	for (const VkSurfaceFormatKHR& format : availableFormats)
+	{
+		if (RenderPass != VK_NULL_HANDLE && format.format == ImageFormat)
+		{
+			surfaceFormat = format;
+			break;
+		}
+	}
+	CRITICAL_ASSERT(RenderPass == VK_NULL_HANDLE || surfaceFormat.format == ImageFormat, "Surface format changed on recreation");
+
+	// Present Mode
+	VkPresentModeKHR presentMode = SelectPresentMode();
+
+	// Extent
+	VkExtent2D extent = {};
+	if (capabilities.currentExtent.width == UINT32_MAX ||
+		capabilities.currentExtent.height == UINT32_MAX)
+	{
+		extent.width = width;
+		extent.height = height;
+	}
+	else
+	{
+		extent = capabilities.currentExtent;
+	}
+
+	// Mailbox/immediate want a spare image to render into while one is queued, FIFO only adds latency with more
+	uint32_t imageCount = DesiredImageCount;
+	if (imageCount == 0)
+	{
+		bool spare = presentMode == VK_PRESENT_MODE_MAILBOX_KHR || presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR;
+		imageCount = capabilities.minImageCount + (spare ? 1 : 0);
+	}
+
+	if (imageCount < capabilities.minImageCount)
+	{
+		imageCount = capabilities.minImageCount;
+	}
+	if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+	{
+		imageCount = capabilities.maxImageCount;
+	}
+
+	VkSwapchainCreateInfoKHR swapchainInfo = {};
+	swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	swapchainInfo.surface = Surface;
+	swapchainInfo.minImageCount = imageCount;
+	swapchainInfo.imageFormat = surfaceFormat.format;
+	swapchainInfo.imageColorSpace = surfaceFormat.colorSpace;
+	swapchainInfo.imageExtent = extent;
+	swapchainInfo.imageArrayLayers = 1;
+	swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	swapchainInfo.preTransform = capabilities.currentTransform;
+	swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	swapchainInfo.presentMode = presentMode;
+	swapchainInfo.clipped = VK_TRUE;
+	swapchainInfo.oldSwapchain = Swapchain; // Null on first creation
+
+	VkResult result = vkCreateSwapchainKHR(Device->Device, &swapchainInfo, nullptr, &Swapchain);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Swapchain creation failed");
+
+	vkGetSwapchainImagesKHR(Device->Device, Swapchain, &imageCount, nullptr);
+	Images.resize(imageCount);
+	vkGetSwapchainImagesKHR(Device->Device, Swapchain, &imageCount, Images.data());
+
+	ImageFormat = surfaceFormat.format;
+	Extent = extent;
+	PresentMode = presentMode;
+}
+
+void VulkanSwapchain::CreateOffscreenImages(uint32_t width, uint32_t height)
+{
+	// One image per frame in flight, the frame fences already keep them from being overwritten while in use
+	uint32_t imageCount = Device->FramesAhead;
+
+	ImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	Extent = { width, height };
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = ImageFormat;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocationInfo = {};
+	allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	Images.resize(imageCount);
+	ImageAllocations.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkResult result = vmaCreateImage(Device->Allocator, &imageInfo, &allocationInfo, &Images[i], &ImageAllocations[i], nullptr);
+		CRITICAL_ASSERT(result == VK_SUCCESS, "Offscreen image creation failed");
+	}
+}
+
+VkExtent2D VulkanSwapchain::GetSurfaceExtent() const
+{
+	VkSurfaceCapabilitiesKHR capabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Device->PhysicalDevice, Surface, &capabilities);
+
+	if (capabilities.currentExtent.width != UINT32_MAX &&
+		capabilities.currentExtent.height != UINT32_MAX)
+	{
+		return capabilities.currentExtent;
+	}
+
+	// Surface size is defined by the swapchain (Wayland), go by the window instead
+	int width = 0;
+	int height = 0;
+	SDL_Vulkan_GetDrawableSize(Device->Window, &width, &height);
+
+	return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+}
+
+VkPresentModeKHR VulkanSwapchain::SelectPresentMode() const
+{
+	uint32_t modeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(Device->PhysicalDevice, Surface, &modeCount, nullptr);
+
+	std::vector<VkPresentModeKHR> availableModes(modeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(Device->PhysicalDevice, Surface, &modeCount, availableModes.data());
+
+	// FIFO is the only mode every implementation has to support, so it ends every list
+	std::vector<VkPresentModeKHR> preferred;
+	switch (Device->Profile)
+	{
+	case PresentProfile::LowLatency:
+		preferred = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	case PresentProfile::MaxThroughput:
+		preferred = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	case PresentProfile::PowerSaving:
+		preferred = { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	}
+
+	for (VkPresentModeKHR mode : preferred)
+	{
+		for (VkPresentModeKHR available : availableModes)
+		{
+			if (mode == available)
+			{
+				if (mode != preferred[0])
+				{
+					LOG_VK("Preferred present mode unsupported, falling back to %d", mode);
+				}
+				return mode;
+			}
+		}
+	}
+
+	return VK_PRESENT_MODE_FIFO_KHR;
 }
\ No newline at end of file
@@ -3,6 +3,14 @@
 #include <vector>
 #include <cstdint>
 #include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+
+enum class PresentProfile
+{
+	LowLatency,    // MAILBOX (FIFO fallback), 1 frame ahead
+	MaxThroughput, // IMMEDIATE (MAILBOX, FIFO fallbacks), several frames ahead
+	PowerSaving    // FIFO_RELAXED (FIFO fallback), vsync'd
+};
 
 class VulkanSwapchain
 {
@@ -15,19 +23,66 @@ public: // TODO: not public?
 	VkSwapchainKHR Swapchain = VK_NULL_HANDLE;
 	VkSurfaceKHR Surface = VK_NULL_HANDLE;
 
-	VkRenderPass RenderPass;
+	VkRenderPass RenderPass = VK_NULL_HANDLE;
 
-	uint32_t CurrentImage;
+	uint32_t CurrentImage = 0;
 
 	std::vector<VkImage> Images; // TODO: rename
+	std::vector<VmaAllocation> ImageAllocations; // Headless only, swapchain images are owned by the surface
 	std::vector<VkImageView> ImageViews;
 	std::vector<VkFramebuffer> Framebuffers;
 
-	VkFormat ImageFormat;
-	VkExtent2D Extent;
+	VkFormat ImageFormat = VK_FORMAT_UNDEFINED;
+	VkExtent2D Extent = {};
+
+	// Set before Create. Without it the main pass has no depth attachment and depth state is ignored.
+	bool UseDepth = false;
+
+	// Shared by every image, the main pass leaves it in SHADER_READ_ONLY_OPTIMAL for the next frame's depth pyramid.
+	// Null without UseDepth.
+	VkImage DepthImage = VK_NULL_HANDLE;
+	VmaAllocation DepthAllocation = nullptr;
+	VkImageView DepthView = VK_NULL_HANDLE;
+	VkFormat DepthFormat = VK_FORMAT_UNDEFINED;
+
+	uint32_t Generation = 0; // Bumped whenever the images are recreated
+
+	VkPresentModeKHR PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	uint32_t DesiredImageCount = 0; // 0 picks per present mode, independent of frames in flight
+
+	bool OutOfDate = false; // Set on resize or out of date/suboptimal results, recreated on the next NextImage
 
 public:
 	void Create(uint32_t width, uint32_t height);
-	uint32_t NextImage(VkSemaphore semaphore);
+	void Recreate(uint32_t width, uint32_t height);
+	void Destroy();
+
+	// Returns false if no image could be acquired (minimized window), the frame has to be skipped
+	bool NextImage(VkSemaphore semaphore);
 	void Present(VkSemaphore waitSemaphore);
+
+protected:
+	struct RetiredSwapchain
+	{
+		VkSwapchainKHR Swapchain = VK_NULL_HANDLE;
+		std::vector<VkImageView> ImageViews;
+		std::vector<VkFramebuffer> Framebuffers;
+		VkImage DepthImage = VK_NULL_HANDLE;
+		VmaAllocation DepthAllocation = nullptr;
+		VkImageView DepthView = VK_NULL_HANDLE;
+		uint64_t Frame = 0;
+	};
+
+	std::vector<RetiredSwapchain> Retired;
+
+	void CreateSurfaceImages(uint32_t width, uint32_t height);
+	void CreateOffscreenImages(uint32_t width, uint32_t height);
+	void CreateDepth();
+	void SelectDepthFormat();
+	void CreateRenderPass();
+	void CreateFramebuffers();
+	void DestroyRetired(bool all);
+
+	VkExtent2D GetSurfaceExtent() const;
+	VkPresentModeKHR SelectPresentMode() const;
 };
\ No newline at end of file
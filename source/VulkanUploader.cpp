@@ -0,0 +1,337 @@
+#include "VulkanUploader.h"
+
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "Common.h"
+
+#include <cstring>
+
+static void GetBufferAccess(BufferType type, VkPipelineStageFlags& stages, VkAccessFlags& access)
+{
+	switch (type)
+	{
+	case BufferType::Vertex:
+		stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		break;
+	case BufferType::Index:
+		stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		access = VK_ACCESS_INDEX_READ_BIT;
+		break;
+	case BufferType::Storage:
+		stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case BufferType::Indirect:
+		stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		break;
+	default:
+		CRITICAL_ERROR("Invalid buffer type");
+	}
+}
+
+VulkanUploader::VulkanUploader()
+{
+}
+
+void VulkanUploader::Create()
+{
+	VkCommandPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	createInfo.queueFamilyIndex = Device->TransferFamily;
+	createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkResult result = vkCreateCommandPool(Device->Device, &createInfo, nullptr, &CommandPool);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to create transfer command pool");
+}
+
+void VulkanUploader::Destroy()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	// Expects the device to be idle
+	if (Recording != nullptr)
+	{
+		vkEndCommandBuffer(Recording->CommandBuffer);
+		InFlight.push_back(Recording);
+		Recording = nullptr;
+	}
+
+	for (Batch* batch : InFlight)
+	{
+		for (StagingPage* page : batch->Pages)
+		{
+			FreePages.push_back(page);
+		}
+		FreeBatches.push_back(batch);
+	}
+	InFlight.clear();
+
+	for (Batch* batch : FreeBatches)
+	{
+		vkDestroyFence(Device->Device, batch->Fence, nullptr);
+		vkDestroySemaphore(Device->Device, batch->Semaphore, nullptr);
+		delete batch;
+	}
+	FreeBatches.clear();
+
+	for (StagingPage* page : FreePages)
+	{
+		vmaDestroyBuffer(Device->Allocator, page->Buffer, page->Allocation);
+		delete page;
+	}
+	FreePages.clear();
+
+	vkDestroyCommandPool(Device->Device, CommandPool, nullptr);
+	CommandPool = VK_NULL_HANDLE;
+}
+
+uint64_t VulkanUploader::Upload(VulkanBuffer* destination, const void* data, VkDeviceSize size, VkDeviceSize offset)
+{
+	CRITICAL_ASSERT(offset + size <= destination->Size, "Upload out of buffer bounds");
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	if (Recording == nullptr)
+	{
+		Recording = BeginBatch();
+	}
+
+	// Copy offsets don't need any alignment, but keep staging writes friendly for memcpy
+	constexpr VkDeviceSize alignment = 16;
+
+	StagingPage* page = Recording->Pages.empty() ? nullptr : Recording->Pages.back();
+	VkDeviceSize stagingOffset = page ? (page->Used + alignment - 1) & ~(alignment - 1) : 0;
+
+	if (page == nullptr || stagingOffset + size > page->Size)
+	{
+		page = AcquirePage(size);
+		Recording->Pages.push_back(page);
+		stagingOffset = 0;
+	}
+
+	memcpy(page->Mapped + stagingOffset, data, static_cast<size_t>(size));
+	page->Used = stagingOffset + size;
+
+	VkBufferCopy region = {};
+	region.srcOffset = stagingOffset;
+	region.dstOffset = offset;
+	region.size = size;
+
+	vkCmdCopyBuffer(Recording->CommandBuffer, page->Buffer, destination->Buffer, 1, &region);
+
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	GetBufferAccess(destination->Type, stages, access);
+
+	// Exclusive buffers written on a different family have to be released here and acquired on graphics
+	if (Device->TransferFamily != Device->GraphicsFamily)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = Device->TransferFamily;
+		barrier.dstQueueFamilyIndex = Device->GraphicsFamily;
+		barrier.buffer = destination->Buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+
+		Recording->Releases.push_back(barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = access;
+
+		Recording->Acquires.push_back(barrier);
+	}
+	Recording->AcquireStages |= stages;
+
+	return Recording->Ticket;
+}
+
+void VulkanUploader::Submit(VkCommandBuffer graphicsCommands)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	WaitSemaphore = VK_NULL_HANDLE;
+	WaitStages = 0;
+
+	Retire();
+
+	if (Recording == nullptr)
+		return;
+
+	Batch* batch = Recording;
+	Recording = nullptr;
+
+	if (!batch->Releases.empty())
+	{
+		vkCmdPipelineBarrier(batch->CommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr,
+			static_cast<uint32_t>(batch->Releases.size()), batch->Releases.data(),
+			0, nullptr);
+	}
+
+	VkResult result = vkEndCommandBuffer(batch->CommandBuffer);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to end transfer command buffer recording");
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch->CommandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &batch->Semaphore;
+
+	result = vkQueueSubmit(Device->TransferQueue, 1, &submitInfo, batch->Fence);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Transfer queue submission failed");
+
+	// The semaphore wait orders the acquire after the release, so the barrier starts at the wait stages
+	if (!batch->Acquires.empty())
+	{
+		vkCmdPipelineBarrier(graphicsCommands,
+			batch->AcquireStages, batch->AcquireStages, 0,
+			0, nullptr,
+			static_cast<uint32_t>(batch->Acquires.size()), batch->Acquires.data(),
+			0, nullptr);
+	}
+
+	WaitSemaphore = batch->Semaphore;
+	WaitStages = batch->AcquireStages;
+
+	batch->Frame = Device->FrameCount;
+	InFlight.push_back(batch);
+}
+
+void VulkanUploader::Retire()
+{
+	// Batches complete in submission order on the transfer queue
+	for (Batch* batch : InFlight)
+	{
+		if (vkGetFenceStatus(Device->Device, batch->Fence) != VK_SUCCESS)
+			break;
+
+		CompletedTicket = batch->Ticket;
+	}
+
+	// The semaphore can only be reused once the graphics submit that waited on it has retired too
+	size_t retired = 0;
+	for (; retired < InFlight.size(); retired++)
+	{
+		Batch* batch = InFlight[retired];
+
+		if (batch->Ticket > CompletedTicket || !Device->IsFrameRetired(batch->Frame))
+			break;
+
+		vkResetFences(Device->Device, 1, &batch->Fence);
+
+		for (StagingPage* page : batch->Pages)
+		{
+			ReleasePage(page);
+		}
+		batch->Pages.clear();
+		batch->Releases.clear();
+		batch->Acquires.clear();
+		batch->AcquireStages = 0;
+
+		FreeBatches.push_back(batch);
+	}
+
+	InFlight.erase(InFlight.begin(), InFlight.begin() + retired);
+}
+
+VulkanUploader::Batch* VulkanUploader::BeginBatch()
+{
+	Batch* batch = nullptr;
+	if (!FreeBatches.empty())
+	{
+		batch = FreeBatches.back();
+		FreeBatches.pop_back();
+	}
+	else
+	{
+		batch = new Batch();
+
+		VkCommandBufferAllocateInfo allocation = {};
+		allocation.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocation.commandPool = CommandPool;
+		allocation.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocation.commandBufferCount = 1;
+
+		VkResult result = vkAllocateCommandBuffers(Device->Device, &allocation, &batch->CommandBuffer);
+		CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate transfer command buffer");
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		vkCreateFence(Device->Device, &fenceInfo, nullptr, &batch->Fence);
+		vkCreateSemaphore(Device->Device, &semaphoreInfo, nullptr, &batch->Semaphore);
+	}
+
+	batch->Ticket = NextTicket++;
+
+	vkResetCommandBuffer(batch->CommandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(batch->CommandBuffer, &beginInfo);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to start transfer command buffer recording");
+
+	return batch;
+}
+
+VulkanUploader::StagingPage* VulkanUploader::AcquirePage(VkDeviceSize size)
+{
+	for (size_t i = 0; i < FreePages.size(); i++)
+	{
+		if (FreePages[i]->Size >= size)
+		{
+			StagingPage* page = FreePages[i];
+			FreePages[i] = FreePages.back();
+			FreePages.pop_back();
+
+			page->Used = 0;
+			return page;
+		}
+	}
+
+	StagingPage* page = new StagingPage();
+	page->Size = size > PAGE_SIZE ? size : PAGE_SIZE;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = page->Size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo allocationInfo = {};
+	allocationInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocationInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo info = {};
+	VkResult result = vmaCreateBuffer(Device->Allocator, &bufferInfo, &allocationInfo, &page->Buffer, &page->Allocation, &info);
+	CRITICAL_ASSERT(result == VK_SUCCESS, "Failed to allocate staging memory");
+
+	page->Mapped = static_cast<uint8_t*>(info.pMappedData);
+
+	return page;
+}
+
+void VulkanUploader::ReleasePage(StagingPage* page)
+{
+	// Oversized pages are one-offs (big meshes etc.), don't let them pile up in the pool
+	if (page->Size > PAGE_SIZE)
+	{
+		vmaDestroyBuffer(Device->Allocator, page->Buffer, page->Allocation);
+		delete page;
+		return;
+	}
+
+	FreePages.push_back(page);
+}
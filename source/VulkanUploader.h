@@ -0,0 +1,81 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "vk_mem_alloc.h"
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+class VulkanBuffer;
+
+// Streams data into device local buffers through pooled staging memory on the transfer queue.
+// Uploads are batched and submitted once per frame from BeginFrame, the frame's graphics submit
+// waits on the batch semaphore so nothing ever stalls on the CPU.
+// Uploaded ranges are usable from the next BeginFrame on.
+class VulkanUploader
+{
+public:
+	VulkanUploader();
+
+	class VulkanDevice* Device;
+
+	void Create();
+	void Destroy();
+
+	// Returns a ticket that can be checked with IsComplete
+	uint64_t Upload(VulkanBuffer* destination, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+	bool IsComplete(uint64_t ticket) const { return ticket <= CompletedTicket; }
+
+	// Submits the recording batch and records the matching queue family acquires into graphicsCommands.
+	// Must be called outside of a render pass.
+	void Submit(VkCommandBuffer graphicsCommands);
+
+	// Semaphore (and stages) the next graphics submit has to wait on, VK_NULL_HANDLE if nothing was submitted
+	VkSemaphore WaitSemaphore = VK_NULL_HANDLE;
+	VkPipelineStageFlags WaitStages = 0;
+
+protected:
+	struct StagingPage
+	{
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		VmaAllocation Allocation = nullptr;
+		uint8_t* Mapped = nullptr;
+		VkDeviceSize Size = 0;
+		VkDeviceSize Used = 0;
+	};
+
+	struct Batch
+	{
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkFence Fence = VK_NULL_HANDLE;
+		VkSemaphore Semaphore = VK_NULL_HANDLE;
+
+		uint64_t Ticket = 0;
+		uint64_t Frame = 0; // Frame whose graphics submit waited on the semaphore
+
+		std::vector<StagingPage*> Pages;
+		std::vector<VkBufferMemoryBarrier> Releases;
+		std::vector<VkBufferMemoryBarrier> Acquires;
+		VkPipelineStageFlags AcquireStages = 0;
+	};
+
+	const VkDeviceSize PAGE_SIZE = 4 * 1024 * 1024;
+
+	VkCommandPool CommandPool = VK_NULL_HANDLE;
+
+	Batch* Recording = nullptr;
+	std::vector<Batch*> InFlight;
+	std::vector<Batch*> FreeBatches;
+	std::vector<StagingPage*> FreePages;
+
+	uint64_t NextTicket = 1;
+	uint64_t CompletedTicket = 0;
+
+	std::mutex Mutex;
+
+	void Retire();
+	Batch* BeginBatch();
+	StagingPage* AcquirePage(VkDeviceSize size);
+	void ReleasePage(StagingPage* page);
+};
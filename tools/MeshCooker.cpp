@@ -0,0 +1,702 @@
+#include "MeshFormat.h"
+#include "File.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+
+// Cooks a Wavefront .obj into a .mesh ready to be copied straight into GPU buffers
+// meshcooker <input.obj> <output.mesh>
+//
+// Triangles are reordered for the post transform cache (Forsyth), then clusters of them are sorted
+// front to back from the outside in to cut overdraw, then vertices are reordered for fetch locality
+// and packed (octahedral normals, half texcoords).
+
+// Full precision while cooking, packed into MeshFormat::Vertex on the way out
+struct Vertex
+{
+	float Position[3];
+	float Normal[3];
+	float TexCoord[2];
+};
+
+struct Float3
+{
+	float X = 0.0f;
+	float Y = 0.0f;
+	float Z = 0.0f;
+};
+
+static Float3 Sub(const Float3& a, const Float3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+static Float3 Add(const Float3& a, const Float3& b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+static Float3 Scale(const Float3& a, float s) { return { a.X * s, a.Y * s, a.Z * s }; }
+static float Dot(const Float3& a, const Float3& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+static Float3 Cross(const Float3& a, const Float3& b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+static Float3 Position(const Vertex& vertex) { return { vertex.Position[0], vertex.Position[1], vertex.Position[2] }; }
+
+static Float3 Normalize(const Float3& a)
+{
+	float length = std::sqrt(Dot(a, a));
+	return length > 0.0f ? Scale(a, 1.0f / length) : a;
+}
+
+// Unnormalized, its length is twice the triangle's area
+static Float3 FaceNormal(const std::vector<Vertex>& vertices, const uint32_t* triangle)
+{
+	Float3 a = Position(vertices[triangle[0]]);
+	return Cross(Sub(Position(vertices[triangle[1]]), a), Sub(Position(vertices[triangle[2]]), a));
+}
+
+// Obj
+
+struct ObjKey
+{
+	int Position;
+	int TexCoord;
+	int Normal;
+
+	bool operator==(const ObjKey& other) const
+	{
+		return Position == other.Position && TexCoord == other.TexCoord && Normal == other.Normal;
+	}
+};
+
+struct ObjKeyHash
+{
+	size_t operator()(const ObjKey& key) const
+	{
+		return (static_cast<size_t>(key.Position) * 73856093) ^ (static_cast<size_t>(key.TexCoord) * 19349663) ^ (static_cast<size_t>(key.Normal) * 83492791);
+	}
+};
+
+// Obj indices are one based, negative ones count back from the end. Returns -1 for missing.
+static int ResolveIndex(long index, size_t count)
+{
+	if (index > 0)
+		return index <= static_cast<long>(count) ? static_cast<int>(index - 1) : -2;
+	if (index < 0)
+		return -index <= static_cast<long>(count) ? static_cast<int>(count + index) : -2;
+	return -1;
+}
+
+static bool LoadObj(const std::string& fileName, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint8_t> bytes;
+	if (!File::TryReadAllBytes(fileName, bytes))
+	{
+		std::printf("Failed to read %s\n", fileName.c_str());
+		return false;
+	}
+	bytes.push_back(0);
+
+	std::vector<Float3> positions;
+	std::vector<Float3> normals;
+	std::vector<Float3> texCoords;
+
+	std::unordered_map<ObjKey, uint32_t, ObjKeyHash> unique;
+	std::vector<uint32_t> polygon;
+	bool missingNormals = false;
+
+	uint32_t lineNumber = 0;
+	char* line = reinterpret_cast<char*>(bytes.data());
+	while (*line)
+	{
+		char* end = line + std::strcspn(line, "\r\n");
+		char next = *end;
+		*end = 0;
+		lineNumber++;
+
+		char* cursor = line + std::strspn(line, " \t");
+		if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+		{
+			Float3 value;
+			value.X = std::strtof(cursor + 1, &cursor);
+			value.Y = std::strtof(cursor, &cursor);
+			value.Z = std::strtof(cursor, &cursor);
+			positions.push_back(value);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 'n')
+		{
+			Float3 value;
+			value.X = std::strtof(cursor + 2, &cursor);
+			value.Y = std::strtof(cursor, &cursor);
+			value.Z = std::strtof(cursor, &cursor);
+			normals.push_back(value);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 't')
+		{
+			Float3 value;
+			value.X = std::strtof(cursor + 2, &cursor);
+			value.Y = std::strtof(cursor, &cursor);
+			texCoords.push_back(value);
+		}
+		else if (cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+		{
+			polygon.clear();
+			cursor++;
+
+			while (true)
+			{
+				cursor += std::strspn(cursor, " \t");
+				if (*cursor == 0)
+					break;
+
+				// v, v/vt, v//vn or v/vt/vn
+				ObjKey key;
+				key.Position = ResolveIndex(std::strtol(cursor, &cursor, 10), positions.size());
+				key.TexCoord = -1;
+				key.Normal = -1;
+				if (*cursor == '/')
+				{
+					cursor++;
+					if (*cursor != '/')
+					{
+						key.TexCoord = ResolveIndex(std::strtol(cursor, &cursor, 10), texCoords.size());
+					}
+					if (*cursor == '/')
+					{
+						cursor++;
+						key.Normal = ResolveIndex(std::strtol(cursor, &cursor, 10), normals.size());
+					}
+				}
+
+				if (key.Position < 0 || key.TexCoord < -1 || key.Normal < -1 || (*cursor != 0 && *cursor != ' ' && *cursor != '\t'))
+				{
+					std::printf("%s(%u): invalid face\n", fileName.c_str(), lineNumber);
+					return false;
+				}
+
+				auto found = unique.find(key);
+				if (found == unique.end())
+				{
+					Vertex vertex = {};
+					const Float3& position = positions[key.Position];
+					vertex.Position[0] = position.X;
+					vertex.Position[1] = position.Y;
+					vertex.Position[2] = position.Z;
+					if (key.Normal >= 0)
+					{
+						const Float3& normal = normals[key.Normal];
+						vertex.Normal[0] = normal.X;
+						vertex.Normal[1] = normal.Y;
+						vertex.Normal[2] = normal.Z;
+					}
+					else
+					{
+						missingNormals = true;
+					}
+					if (key.TexCoord >= 0)
+					{
+						// Obj has the origin at the bottom left, Vulkan samples from the top left
+						vertex.TexCoord[0] = texCoords[key.TexCoord].X;
+						vertex.TexCoord[1] = 1.0f - texCoords[key.TexCoord].Y;
+					}
+
+					found = unique.emplace(key, static_cast<uint32_t>(vertices.size())).first;
+					vertices.push_back(vertex);
+				}
+				polygon.push_back(found->second);
+			}
+
+			// Fan, fine for the convex polygons exporters write
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				indices.push_back(polygon[0]);
+				indices.push_back(polygon[i - 1]);
+				indices.push_back(polygon[i]);
+			}
+		}
+
+		line = next ? end + 1 : end;
+	}
+
+	// Area weighted over the faces sharing the vertex, for those that didn't come with one
+	if (missingNormals)
+	{
+		std::vector<Float3> accumulated(vertices.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			Float3 normal = FaceNormal(vertices, &indices[i]);
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				accumulated[indices[i + corner]] = Add(accumulated[indices[i + corner]], normal);
+			}
+		}
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			Vertex& vertex = vertices[i];
+			if (vertex.Normal[0] == 0.0f && vertex.Normal[1] == 0.0f && vertex.Normal[2] == 0.0f)
+			{
+				Float3 normal = Normalize(accumulated[i]);
+				vertex.Normal[0] = normal.X;
+				vertex.Normal[1] = normal.Y;
+				vertex.Normal[2] = normal.Z;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Vertex cache
+
+// FIFO size close to what current GPUs effectively reuse over
+const uint32_t SIMULATED_CACHE_SIZE = 16;
+
+// Average cache misses per triangle, 3 is no reuse at all, 0.5 is the best a regular grid can do
+static float ComputeAcmr(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	if (indices.empty())
+		return 0.0f;
+
+	// Timestamps instead of an actual FIFO, a vertex is cached if it was added within the last N misses
+	std::vector<uint32_t> addedAt(vertexCount, 0);
+	uint32_t misses = 0;
+	for (uint32_t index : indices)
+	{
+		if (addedAt[index] == 0 || misses + 1 - addedAt[index] > SIMULATED_CACHE_SIZE)
+		{
+			misses++;
+			addedAt[index] = misses;
+		}
+	}
+
+	return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+static float VertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// Just used by the last triangle, deliberately below the next few so strips don't win outright
+			score = 0.75f;
+		}
+		else
+		{
+			float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+
+	// Prefer finishing off vertices with few triangles left so they don't linger as lone stragglers
+	return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+static std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// Per vertex ranges of the triangles still to be emitted
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		remaining[index]++;
+	}
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		offsets[i + 1] = offsets[i] + remaining[i];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[fill[indices[i]]++] = i / 3;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		vertexScores[i] = VertexScore(-1, remaining[i]);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint32_t scanCursor = 0;
+	int best = -1;
+
+	while (output.size() < indices.size())
+	{
+		// Nothing in the cache has triangles left, carry on with the next one in source order.
+		// Picking the best scored one here instead would make this quadratic on meshes with many pieces.
+		if (best < 0)
+		{
+			while (emitted[scanCursor])
+			{
+				scanCursor++;
+			}
+			best = static_cast<int>(scanCursor);
+		}
+
+		const uint32_t* triangle = &indices[best * 3];
+		emitted[best] = true;
+
+		nextCache.clear();
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = triangle[corner];
+			output.push_back(vertex);
+			nextCache.push_back(vertex);
+
+			// Swap remove the triangle from the vertex's remaining range
+			uint32_t* begin = &adjacency[offsets[vertex]];
+			uint32_t* end = begin + remaining[vertex];
+			*std::find(begin, end, static_cast<uint32_t>(best)) = *(end - 1);
+			remaining[vertex]--;
+		}
+
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				nextCache.push_back(vertex);
+			}
+		}
+
+		// Whatever got pushed out loses its cache bonus
+		for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++)
+		{
+			cachePositions[nextCache[i]] = -1;
+			vertexScores[nextCache[i]] = VertexScore(-1, remaining[nextCache[i]]);
+		}
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+		{
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		}
+		cache.swap(nextCache);
+
+		for (uint32_t i = 0; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = static_cast<int>(i);
+			vertexScores[cache[i]] = VertexScore(static_cast<int>(i), remaining[cache[i]]);
+		}
+
+		// Only triangles touching the cache changed score, the next pick is always among them
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t i = offsets[vertex]; i < offsets[vertex] + remaining[vertex]; i++)
+			{
+				uint32_t candidate = adjacency[i];
+				const uint32_t* corners = &indices[candidate * 3];
+				float score = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = static_cast<int>(candidate);
+				}
+			}
+		}
+	}
+
+	return output;
+}
+
+// Overdraw, after Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+// The cache optimized order is cut into clusters wherever the cache starts cold anyway (or close enough to
+// cost nothing), then clusters facing out from the middle of the mesh go first, since from most viewpoints
+// they occlude the ones facing in.
+const float OVERDRAW_THRESHOLD = 1.05f; // Accepted ACMR increase for extra cluster boundaries
+
+static std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	// Hard boundaries, triangles where all three vertices miss the simulated cache
+	std::vector<uint32_t> hardBoundaries;
+	{
+		std::vector<uint32_t> addedAt(vertexCount, 0);
+		uint32_t misses = 0;
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			uint32_t triangleMisses = 0;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t index = indices[i * 3 + corner];
+				if (addedAt[index] == 0 || misses + 1 - addedAt[index] > SIMULATED_CACHE_SIZE)
+				{
+					misses++;
+					triangleMisses++;
+					addedAt[index] = misses;
+				}
+			}
+
+			if (i == 0 || triangleMisses == 3)
+			{
+				hardBoundaries.push_back(i);
+			}
+		}
+		hardBoundaries.push_back(triangleCount);
+	}
+
+	// Soft boundaries, split a hard cluster again wherever the part so far already reuses as well as
+	// the whole cluster does. Each part simulates from a cold cache since it can end up anywhere.
+	std::vector<uint32_t> boundaries;
+	for (size_t cluster = 0; cluster + 1 < hardBoundaries.size(); cluster++)
+	{
+		uint32_t begin = hardBoundaries[cluster];
+		uint32_t end = hardBoundaries[cluster + 1];
+
+		std::vector<uint32_t> part(indices.begin() + begin * 3, indices.begin() + end * 3);
+		float target = ComputeAcmr(part, vertexCount) * OVERDRAW_THRESHOLD;
+
+		std::vector<uint32_t> addedAt(vertexCount, 0);
+		uint32_t generation = 0; // Misses since the start of the simulation, restarts are done by skipping ahead
+		uint32_t partStart = begin;
+		uint32_t partMisses = 0;
+
+		boundaries.push_back(begin);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t index = indices[i * 3 + corner];
+				if (addedAt[index] == 0 || generation + 1 - addedAt[index] > SIMULATED_CACHE_SIZE)
+				{
+					generation++;
+					partMisses++;
+					addedAt[index] = generation;
+				}
+			}
+
+			float acmr = static_cast<float>(partMisses) / (i + 1 - partStart);
+			if (i + 1 < end && acmr <= target)
+			{
+				boundaries.push_back(i + 1);
+				partStart = i + 1;
+				partMisses = 0;
+				generation += SIMULATED_CACHE_SIZE; // Everything cached falls out
+			}
+		}
+	}
+	boundaries.push_back(triangleCount);
+
+	// Area weighted centroid of the whole mesh
+	Float3 meshCentroid;
+	float meshArea = 0.0f;
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		const uint32_t* triangle = &indices[i * 3];
+		float area = std::sqrt(Dot(FaceNormal(vertices, triangle), FaceNormal(vertices, triangle)));
+		Float3 centroid = Scale(Add(Add(Position(vertices[triangle[0]]), Position(vertices[triangle[1]])), Position(vertices[triangle[2]])), 1.0f / 3.0f);
+		meshCentroid = Add(meshCentroid, Scale(centroid, area));
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+	{
+		meshCentroid = Scale(meshCentroid, 1.0f / meshArea);
+	}
+
+	struct Cluster
+	{
+		uint32_t Begin;
+		uint32_t End;
+		float SortKey;
+	};
+
+	std::vector<Cluster> clusters;
+	clusters.reserve(boundaries.size() - 1);
+	for (size_t i = 0; i + 1 < boundaries.size(); i++)
+	{
+		Cluster cluster;
+		cluster.Begin = boundaries[i];
+		cluster.End = boundaries[i + 1];
+
+		Float3 centroid;
+		Float3 normal;
+		float area = 0.0f;
+		for (uint32_t triangle = cluster.Begin; triangle < cluster.End; triangle++)
+		{
+			const uint32_t* corners = &indices[triangle * 3];
+			Float3 faceNormal = FaceNormal(vertices, corners);
+			float faceArea = std::sqrt(Dot(faceNormal, faceNormal));
+			Float3 faceCentroid = Scale(Add(Add(Position(vertices[corners[0]]), Position(vertices[corners[1]])), Position(vertices[corners[2]])), 1.0f / 3.0f);
+
+			centroid = Add(centroid, Scale(faceCentroid, faceArea));
+			normal = Add(normal, faceNormal);
+			area += faceArea;
+		}
+		if (area > 0.0f)
+		{
+			centroid = Scale(centroid, 1.0f / area);
+		}
+
+		cluster.SortKey = Dot(Sub(centroid, meshCentroid), Normalize(normal));
+		clusters.push_back(cluster);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+	{
+		return a.SortKey > b.SortKey;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (const Cluster& cluster : clusters)
+	{
+		output.insert(output.end(), indices.begin() + cluster.Begin * 3, indices.begin() + cluster.End * 3);
+	}
+
+	std::printf("Overdraw: %zu clusters (%zu hard)\n", clusters.size(), hardBoundaries.size() - 1);
+	return output;
+}
+
+// Vertex fetch, vertices in the order the indices first touch them so fetches stream through memory.
+// Also drops vertices nothing references.
+static void OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+{
+	const uint32_t unused = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+static uint64_t Align(uint64_t value)
+{
+	return (value + MeshFormat::Alignment - 1) & ~(MeshFormat::Alignment - 1);
+}
+
+int main(int argc, char* args[])
+{
+	if (argc < 3)
+	{
+		std::printf("usage: meshcooker <input.obj> <output.mesh>\n");
+		return 1;
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	if (!LoadObj(args[1], vertices, indices))
+		return 1;
+
+	if (indices.empty())
+	{
+		std::printf("%s has no triangles\n", args[1]);
+		return 1;
+	}
+
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	std::printf("%s: %u vertices, %zu triangles\n", args[1], vertexCount, indices.size() / 3);
+
+	float acmrBefore = ComputeAcmr(indices, vertexCount);
+	indices = OptimizeVertexCache(indices, vertexCount);
+	float acmrCache = ComputeAcmr(indices, vertexCount);
+	indices = OptimizeOverdraw(indices, vertices);
+	float acmrAfter = ComputeAcmr(indices, vertexCount);
+	std::printf("ACMR: %.3f source, %.3f cache optimized, %.3f after overdraw sort\n", acmrBefore, acmrCache, acmrAfter);
+
+	OptimizeVertexFetch(indices, vertices);
+	vertexCount = static_cast<uint32_t>(vertices.size());
+
+	MeshFormat::Header header = {};
+	header.Magic = MeshFormat::Magic;
+	header.Version = MeshFormat::Version;
+	header.VertexCount = vertexCount;
+	header.VertexStride = sizeof(MeshFormat::Vertex);
+	header.IndexCount = static_cast<uint32_t>(indices.size());
+	header.IndexSize = vertexCount <= 0x10000 ? 2 : 4;
+
+	Float3 boundsMin = Position(vertices[0]);
+	Float3 boundsMax = boundsMin;
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin.X = std::min(boundsMin.X, vertex.Position[0]);
+		boundsMin.Y = std::min(boundsMin.Y, vertex.Position[1]);
+		boundsMin.Z = std::min(boundsMin.Z, vertex.Position[2]);
+		boundsMax.X = std::max(boundsMax.X, vertex.Position[0]);
+		boundsMax.Y = std::max(boundsMax.Y, vertex.Position[1]);
+		boundsMax.Z = std::max(boundsMax.Z, vertex.Position[2]);
+	}
+
+	Float3 center = Scale(Add(boundsMin, boundsMax), 0.5f);
+	float radiusSquared = 0.0f;
+	for (const Vertex& vertex : vertices)
+	{
+		Float3 offset = Sub(Position(vertex), center);
+		radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+	}
+
+	std::memcpy(header.BoundsMin, &boundsMin, sizeof(header.BoundsMin));
+	std::memcpy(header.BoundsMax, &boundsMax, sizeof(header.BoundsMax));
+	std::memcpy(header.Center, &center, sizeof(header.Center));
+	header.Radius = std::sqrt(radiusSquared);
+
+	header.VerticesOffset = Align(sizeof(header));
+	header.IndicesOffset = Align(header.VerticesOffset + static_cast<uint64_t>(vertexCount) * header.VertexStride);
+
+	std::vector<uint8_t> mesh(header.IndicesOffset + static_cast<uint64_t>(header.IndexCount) * header.IndexSize, 0);
+	std::memcpy(mesh.data(), &header, sizeof(header));
+	MeshFormat::Vertex* packed = reinterpret_cast<MeshFormat::Vertex*>(mesh.data() + header.VerticesOffset);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		std::memcpy(packed[i].Position, vertices[i].Position, sizeof(packed[i].Position));
+		VertexFormat::EncodeOctahedral16(vertices[i].Normal, packed[i].Normal);
+		packed[i].TexCoord[0] = VertexFormat::EncodeHalf(vertices[i].TexCoord[0]);
+		packed[i].TexCoord[1] = VertexFormat::EncodeHalf(vertices[i].TexCoord[1]);
+	}
+
+	if (header.IndexSize == 2)
+	{
+		uint16_t* narrow = reinterpret_cast<uint16_t*>(mesh.data() + header.IndicesOffset);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			narrow[i] = static_cast<uint16_t>(indices[i]);
+		}
+	}
+	else
+	{
+		std::memcpy(mesh.data() + header.IndicesOffset, indices.data(), indices.size() * sizeof(uint32_t));
+	}
+
+	if (!File::WriteAllBytesAtomic(args[2], mesh.data(), mesh.size()))
+	{
+		std::printf("Failed to write %s\n", args[2]);
+		return 1;
+	}
+
+	std::printf("Cooked %s (%llu bytes)\n", args[2], static_cast<unsigned long long>(mesh.size()));
+	return 0;
+}
\ No newline at end of file
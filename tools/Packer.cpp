@@ -0,0 +1,144 @@
+#include "ArchiveFormat.h"
+#include "File.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+
+// Packs every file under a directory into a .pak archive
+// packer <output.pak> <directory>
+
+namespace fs = std::filesystem;
+
+struct PackedFile
+{
+	std::string Name;
+	fs::path Path;
+	uint64_t Hash = 0;
+	File::MappedFile Mapping;
+};
+
+static uint64_t Align(uint64_t value)
+{
+	return (value + ArchiveFormat::Alignment - 1) & ~(ArchiveFormat::Alignment - 1);
+}
+
+int main(int argc, char* args[])
+{
+	if (argc < 3)
+	{
+		std::printf("usage: packer <output.pak> <directory>\n");
+		return 1;
+	}
+
+	fs::path output = fs::absolute(args[1]);
+	fs::path root = args[2];
+
+	std::vector<PackedFile> files;
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(root))
+	{
+		if (!entry.is_regular_file() || fs::absolute(entry.path()) == output)
+			continue;
+
+		PackedFile file;
+		file.Name = fs::relative(entry.path(), root).generic_string();
+		file.Path = entry.path();
+		file.Hash = ArchiveFormat::Hash(file.Name.data(), file.Name.size());
+
+		if (!File::TryMap(file.Path.string(), file.Mapping))
+		{
+			std::printf("Failed to read %s\n", file.Path.string().c_str());
+			return 1;
+		}
+
+		files.push_back(std::move(file));
+	}
+
+	// Hash order, ties by name so the output is reproducible
+	std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b)
+	{
+		return a.Hash != b.Hash ? a.Hash < b.Hash : a.Name < b.Name;
+	});
+
+	for (size_t i = 1; i < files.size(); i++)
+	{
+		if (files[i].Hash == files[i - 1].Hash)
+		{
+			std::printf("Warning: %s and %s share a hash, lookups fall back to comparing names\n", files[i - 1].Name.c_str(), files[i].Name.c_str());
+		}
+	}
+
+	uint32_t entryCount = static_cast<uint32_t>(files.size());
+
+	ArchiveFormat::Header header = {};
+	header.Magic = ArchiveFormat::Magic;
+	header.Version = ArchiveFormat::Version;
+	header.EntryCount = entryCount;
+	header.BucketCount = ArchiveFormat::GetBucketCount(entryCount);
+
+	std::string names;
+	for (const PackedFile& file : files)
+	{
+		names += file.Name;
+	}
+
+	header.EntriesOffset = Align(sizeof(header));
+	header.BucketsOffset = Align(header.EntriesOffset + sizeof(ArchiveFormat::Entry) * entryCount);
+	header.NamesOffset = Align(header.BucketsOffset + sizeof(uint32_t) * header.BucketCount);
+	header.NamesSize = names.size();
+
+	std::vector<ArchiveFormat::Entry> entries(entryCount);
+	std::vector<uint32_t> buckets(header.BucketCount, ArchiveFormat::EmptyBucket);
+
+	uint64_t offset = Align(header.NamesOffset + header.NamesSize);
+	uint32_t nameOffset = 0;
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		ArchiveFormat::Entry& entry = entries[i];
+		entry.NameHash = files[i].Hash;
+		entry.NameOffset = nameOffset;
+		entry.NameLength = static_cast<uint32_t>(files[i].Name.size());
+		entry.Offset = offset;
+		entry.Size = files[i].Mapping.Size();
+
+		nameOffset += entry.NameLength;
+		offset = Align(offset + entry.Size);
+
+		uint32_t mask = header.BucketCount - 1;
+		uint32_t bucket = static_cast<uint32_t>(entry.NameHash) & mask;
+		while (buckets[bucket] != ArchiveFormat::EmptyBucket)
+		{
+			bucket = (bucket + 1) & mask;
+		}
+		buckets[bucket] = i;
+	}
+
+	std::vector<uint8_t> archive(offset, 0);
+	std::memcpy(archive.data(), &header, sizeof(header));
+	if (entryCount > 0)
+	{
+		std::memcpy(archive.data() + header.EntriesOffset, entries.data(), sizeof(ArchiveFormat::Entry) * entryCount);
+	}
+	std::memcpy(archive.data() + header.BucketsOffset, buckets.data(), sizeof(uint32_t) * header.BucketCount);
+	std::memcpy(archive.data() + header.NamesOffset, names.data(), names.size());
+
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		if (entries[i].Size > 0)
+		{
+			std::memcpy(archive.data() + entries[i].Offset, files[i].Mapping.Data(), entries[i].Size);
+		}
+	}
+
+	if (!File::WriteAllBytesAtomic(output.string(), archive.data(), archive.size()))
+	{
+		std::printf("Failed to write %s\n", output.string().c_str());
+		return 1;
+	}
+
+	std::printf("Packed %u files into %s (%llu bytes)\n", entryCount, output.string().c_str(), static_cast<unsigned long long>(archive.size()));
+	return 0;
+}
\ No newline at end of file